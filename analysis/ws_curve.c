@@ -0,0 +1,218 @@
+/* ws_curve.c */
+#include <stdbool.h>      // bool
+#include <stdint.h>       // fixed width types
+#include <stdlib.h>       // calloc, free
+
+#include "ws_curve.h"
+#include "memory.h"       // OFFSET_BITS, enum memsim_error
+
+#define WSC_TABLE_SIZE 1024     // Initial # slots per process
+
+
+// Slot of page `key` in the table: where it is, or the free one it goes to
+static struct wsc_page *find_page(struct wsc_process *p, uint32_t key);
+
+// Doubles the table of a process. Returns 0 if out of memory, else 1.
+static int  grow(struct wsc_process *p);
+
+/* ========================================================================== */
+
+struct ws_curve *wsc_init(uint8_t *pids, size_t max_window)
+{
+  struct ws_curve *c = calloc(1, sizeof(struct ws_curve));
+  if (c == NULL) return NULL;
+
+  c->max_window = max_window;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    struct wsc_process *p = &c->procs[i];
+
+    p->pid = pids[i];
+    p->table_size = WSC_TABLE_SIZE;
+    p->table = calloc(p->table_size, sizeof(struct wsc_page));
+    p->gaps  = calloc(max_window + 1, sizeof(size_t));
+    p->tails = calloc(max_window + 1, sizeof(size_t));
+
+    if (p->table == NULL || p->gaps == NULL || p->tails == NULL)
+    {
+      wsc_clean(c);
+      return NULL;
+    }
+  }
+
+  return c;
+}
+
+/* ========================================================================== */
+
+int wsc_add(struct ws_curve *c, size_t index, uint32_t addr)
+{
+  struct wsc_process *p = &c->procs[index];
+  uint32_t key = (addr >> OFFSET_BITS) + 1;       // Never 0
+
+  uint64_t t = ++p->refs;
+  struct wsc_page *page = find_page(p, key);
+
+  if (page->key)
+  {
+    uint64_t gap = t - page->last;
+
+    if (gap <= c->max_window)
+      ++p->gaps[gap];
+    else
+      ++p->far;
+
+    page->last = t;
+    return MEMSIM_OK;
+  }
+
+  ++p->cold;
+  *page = (struct wsc_page) { .key = key, .last = t };
+
+  if (++p->pages * 2 > p->table_size && !grow(p))     // At most half full
+    return MEMSIM_ENOMEM;
+
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+int wsc_run(struct ws_curve *c, ref_source read_ref, void **srcs, size_t q, size_t max_refs)
+{
+  bool ended[NUM_OF_PROCESSES] = { 0 };
+  size_t n_ended = 0;
+  size_t refs = 0;
+
+  if (q == 0) q = 1;
+
+  while (n_ended < NUM_OF_PROCESSES)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      for (size_t j = 0; j < q && !ended[i]; ++j)
+      {
+        if (max_refs && refs == max_refs) return MEMSIM_OK;
+
+        uint32_t addr;
+        char mode;
+
+        int status = read_ref(srcs[i], &addr, &mode);
+
+        if (status == REF_AGAIN) break;       // Another process has to read first
+        if (status == REF_ERROR) return MEMSIM_EIO;
+        if (status == REF_END)
+        {
+          ended[i] = 1;
+          ++n_ended;
+          break;
+        }
+
+        ++refs;
+        if (wsc_add(c, i, addr) != MEMSIM_OK)
+          return MEMSIM_ENOMEM;
+      }
+    }
+  }
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+void wsc_curves(struct ws_curve *c, size_t index, double *m, double *s)
+{
+  struct wsc_process *p = &c->procs[index];
+  double n = (p->refs ? p->refs : 1);
+
+  size_t max = c->max_window;
+  size_t far_tails = 0;           // # Pages with a tail > max_window
+
+  for (size_t g = 0; g <= max; ++g)
+    p->tails[g] = 0;
+
+  for (size_t i = 0; i < p->table_size; ++i)
+  {                               // A page stays in the Working Sets until the end, at most
+    if (p->table[i].key == 0) continue;
+
+    uint64_t tail = p->refs - p->table[i].last + 1;
+    if (tail <= max)
+      ++p->tails[tail];
+    else
+      ++far_tails;
+  }
+
+  size_t greater = p->cold + p->far;      // # References with a gap > T
+  size_t spans   = p->far + far_tails;    // # Working Set spans > T: gaps, then tails
+
+  s[0] = 0.0;
+  for (size_t T = max + 1; T-- > 0; )
+  {
+    m[T] = greater / n;
+    greater += p->gaps[T];
+
+    s[T] = spans;                 // Sums are taken below
+    spans += p->gaps[T] + p->tails[T];
+  }
+
+  // Each reference is in the sets of the next min(T, span) references
+  double sum = 0.0;
+  for (size_t T = 0; T <= max; ++T)
+  {
+    double more = s[T];           // # Spans > T
+    s[T] = sum / n;
+    sum += more;
+  }
+}
+
+/* ========================================================================== */
+
+void wsc_clean(struct ws_curve *c)
+{
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    free(c->procs[i].table);
+    free(c->procs[i].gaps);
+    free(c->procs[i].tails);
+  }
+  free(c);
+}
+
+/* ========================================================================== */
+
+static struct wsc_page *find_page(struct wsc_process *p, uint32_t key)
+{
+  size_t mask = p->table_size - 1;
+  size_t i = (key * 2654435761u) & mask;
+
+  while (p->table[i].key && p->table[i].key != key)
+    i = (i + 1) & mask;
+
+  return &p->table[i];
+}
+
+/* ========================================================================== */
+
+static int grow(struct wsc_process *p)
+{
+  struct wsc_page *old = p->table;
+  size_t old_size = p->table_size;
+
+  p->table = calloc(2 * old_size, sizeof(struct wsc_page));
+  if (p->table == NULL)
+  {
+    p->table = old;
+    return 0;
+  }
+  p->table_size = 2 * old_size;
+
+  for (size_t i = 0; i < old_size; ++i)
+  {
+    if (old[i].key)
+      *find_page(p, old[i].key) = old[i];
+  }
+
+  free(old);
+  return 1;
+}
+
+/* ========================================================================== */
@@ -0,0 +1,78 @@
+/* ws_curve.h */
+#ifndef WS_CURVE_MODULE
+#define WS_CURVE_MODULE
+
+#include <stdint.h>     // uint8_t, uint32_t, uint64_t, size_t
+
+#include "memory.h"     // NUM_OF_PROCESSES
+#include "scheduler.h"  // ref_source
+
+/* Working Set curves of every window size in one pass (Denning & Slutz). *
+ * The gap of a reference is the # references the process made since its  *
+ * last reference to the same page. With a window of T references:        *
+ *   m(T) = fraction of references with a gap > T (or first references),  *
+ *          the fault rate of the Working Set algorithm with T,           *
+ *   s(T) = mean # distinct pages in the last T references, its mean     *
+ *          Working Set size: m(0) + ... + m(T - 1), corrected for the    *
+ *          end of the trace (Slutz) so both are exact, not estimates.    *
+ * Windows are per process, as the History Windows are.                   */
+
+// Last reference of a page
+struct wsc_page
+{
+  uint32_t key;               // Page address + 1, 0 if the slot is free
+  uint64_t last;              // Index of its last reference
+};
+
+
+// Gaps of the references of a process
+struct wsc_process
+{
+  uint8_t pid;
+  size_t refs;                // # References
+  size_t cold;                // # First references to a page
+  size_t pages;               // # Distinct pages
+
+  struct wsc_page *table;     // Pages seen, open addressing
+  size_t table_size;          // Power of 2
+
+  size_t *gaps;               // gaps[g]: # references with gap g, up to the max window
+  size_t far;                 // # References with a greater gap
+  size_t *tails;              // tails[g]: # pages last referenced g references before the end
+};
+
+
+struct ws_curve
+{
+  size_t max_window;
+  struct wsc_process procs[NUM_OF_PROCESSES];
+};
+
+
+/* Sets up the curves of the processes `pids`, for windows up to `max_window`. *
+ * Returns NULL if out of memory.                                              */
+struct ws_curve *wsc_init(uint8_t *pids, size_t max_window);
+
+
+/* Records a reference of the process in slot `index`.        *
+ * Returns MEMSIM_OK, or MEMSIM_ENOMEM if it couldn't be.     */
+int  wsc_add(struct ws_curve *c, size_t index, uint32_t addr);
+
+
+/* Reads the processes' references q at a time, round-robin, until they  *
+ * end or `max_refs` are read (0 for no limit), and records them.         *
+ * Returns MEMSIM_OK, MEMSIM_ENOMEM if it stopped out of memory, or      *
+ * MEMSIM_EIO if a trace couldn't be read.                                */
+int  wsc_run(struct ws_curve *c, ref_source read_ref, void **srcs, size_t q, size_t max_refs);
+
+
+/* Gets the curves of the process in slot `index`: `m[T]` and `s[T]` for *
+ * every window T in [0, max_window]. Both arrays hold max_window + 1.    */
+void wsc_curves(struct ws_curve *c, size_t index, double *m, double *s);
+
+
+/* Deallocates the curves. */
+void wsc_clean(struct ws_curve *c);
+
+
+#endif
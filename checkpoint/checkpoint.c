@@ -0,0 +1,504 @@
+/* checkpoint.c */
+#include <stdbool.h>      // bool
+#include <stdint.h>       // fixed width types
+#include <stdio.h>        // FILE, fopen, fwrite, fread, rename, sprintf
+#include <stdlib.h>       // malloc, free
+#include <string.h>       // memcmp, strlen
+
+#include "checkpoint.h"
+#include "memory.h"       // struct memory, NUM_OF_PROCESSES
+#include "queue.h"        // queue_insert_last()
+#include "scheduler.h"
+#include "sharing.h"      // share_diverge()
+#include "trace.h"        // trace_tell(), trace_seek()
+
+/* Snapshot layout, every field in host byte order:
+ * Header:    magic, version, # processes
+ * Config:    frames, algorithm, Working Set window, PIDs,
+ *            shared segments, forked processes
+ * Memory:    counters, then every frame (IPT + Main Memory entry)
+ * Sharing:   pages each forked process has its own copy of
+ * WS:        every History Window, oldest reference first
+ * Scheduler: counters, every PCB with its staged references, suspensions
+ * Traces:    input offset and # references to skip, per process      */
+
+// Snapshot file being written/read, remembers the first error
+struct snapshot
+{
+  FILE *f;
+  bool  failed;
+};
+
+static void     put(struct snapshot *ss, const void *v, size_t size);
+static void     get(struct snapshot *ss, void *v, size_t size);
+
+static void     put_u64(struct snapshot *ss, uint64_t v);
+static uint64_t get_u64(struct snapshot *ss);
+
+// Writes/compares the shared segments and forked processes, none if nothing is shared
+static void     put_sharing(struct snapshot *ss, struct sharing_comp *sh);
+static bool     same_sharing(struct snapshot *ss, struct sharing_comp *sh);
+
+/* ========================================================================== */
+
+int ckpt_save(const char *path, struct memory *mem, struct scheduler *s, struct trace **traces)
+{
+  if (mem->vmem->pt)
+    return CKPT_EPAGETABLE;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (!traces[i] || !traces[i]->seekable)
+      return CKPT_ETRACE;
+  }
+
+  char *tmp = malloc(strlen(path) + 5);
+  if (tmp == NULL)
+    return CKPT_ENOMEM;
+  sprintf(tmp, "%s.tmp", path);
+
+  struct snapshot ss = { fopen(tmp, "wb"), 0 };
+  if (ss.f == NULL)
+  {
+    free(tmp);
+    return CKPT_EIO;
+  }
+
+  struct virtual_memory *vm = mem->vmem;
+  struct main_memory    *mm = mem->mmem;
+
+  /* Header & config */
+  put(&ss, CKPT_MAGIC, 8);
+  put_u64(&ss, CKPT_VERSION);
+  put_u64(&ss, NUM_OF_PROCESSES);
+
+  put_u64(&ss, vm->ipt_size);
+  put_u64(&ss, vm->pg_repl);
+  put_u64(&ss, vm->pg_repl == WS ? vm->ws->window_s : 0);
+  put_u64(&ss, vm->page_shift);
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    put_u64(&ss, s->procs[i].pid);
+  put_sharing(&ss, vm->share);
+
+  /* Memory */
+  put_u64(&ss, mem->hd_reads);
+  put_u64(&ss, mem->hd_writes);
+  put_u64(&ss, mem->page_fs);
+  put_u64(&ss, mem->total_req);
+  put_u64(&ss, mem->starvations);
+  put_u64(&ss, mem->cow_faults);
+  put_u64(&ss, mem->shared_hits);
+  put_u64(&ss, mem->frames_saved);
+  put_u64(&ss, mem->peak_saved);
+  put_u64(&ss, vm->ipt_curr);
+
+  for (size_t i = 0; i < vm->ipt_size; ++i)
+  {
+    put_u64(&ss, vm->ipt[i].set);
+    put_u64(&ss, vm->ipt[i].pid);
+    put_u64(&ss, vm->ipt[i].addr);
+    put_u64(&ss, vm->ipt[i].share);
+    put_u64(&ss, vm->ipt[i].nmap);
+    put_u64(&ss, vm->ipt[i].mappers);
+    put_u64(&ss, mm->entries[i].set);
+    put_u64(&ss, mm->entries[i].modified);
+    put_u64(&ss, mm->entries[i].offset);
+    put_u64(&ss, mm->entries[i].latency);
+  }
+
+  /* Sharing */
+  if (vm->share)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      struct page_set *set = &vm->share->diverged[i];
+
+      put_u64(&ss, set->count);
+      for (size_t j = 0; j < set->size; ++j)
+      {
+        if (set->keys[j])
+          put_u64(&ss, set->keys[j] - 1);
+      }
+    }
+  }
+
+  /* Working Set */
+  if (vm->pg_repl == WS)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      put_u64(&ss, vm->ws->history[i]->size);
+
+      for (struct queue_node *n = vm->ws->history[i]->front; n; n = n->next)
+      {
+        put_u64(&ss, n->data.pid);
+        put_u64(&ss, n->data.addr);
+      }
+    }
+  }
+
+  /* Scheduler */
+  put_u64(&ss, (uint64_t) (int64_t) s->curr);
+  put_u64(&ss, (uint64_t) (int64_t) s->last);
+  put_u64(&ss, s->slice);
+  put_u64(&ss, s->clock);
+  put_u64(&ss, s->busy);
+  put_u64(&ss, s->switch_t);
+  put_u64(&ss, s->ctx_switches);
+  put_u64(&ss, s->refs);
+  put_u64(&ss, s->lc_refs);
+  put_u64(&ss, s->lc_faults);
+  put_u64(&ss, s->lc_starv);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    struct process *p = &s->procs[i];
+
+    put_u64(&ss, p->state);
+    put_u64(&ss, p->wake);
+    put_u64(&ss, p->refs);
+    put_u64(&ss, p->faults);
+    put_u64(&ss, p->dispatches);
+    put_u64(&ss, p->blocked_t);
+    put_u64(&ss, p->finish);
+    put_u64(&ss, p->need);
+    put_u64(&ss, p->susp_t);
+
+    put_u64(&ss, p->st_count - p->st_head);       // Read from the trace, not run yet
+    put(&ss, &p->st_addrs[p->st_head], (p->st_count - p->st_head) * sizeof(uint32_t));
+    put(&ss, &p->st_modes[p->st_head], (p->st_count - p->st_head) * sizeof(char));
+    put_u64(&ss, p->ended);
+  }
+
+  put_u64(&ss, s->n_susp);
+  for (size_t i = 0; i < s->n_susp; ++i)
+  {
+    put_u64(&ss, s->susp[i].pid);
+    put_u64(&ss, s->susp[i].start);
+    put_u64(&ss, s->susp[i].end);
+    put_u64(&ss, s->susp[i].freed);
+  }
+
+  /* Traces */
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    uint64_t off;
+    size_t skip;
+
+    trace_tell(traces[i], &off, &skip);
+    put_u64(&ss, off);
+    put_u64(&ss, skip);
+  }
+
+  bool failed = ss.failed;
+
+  if (fclose(ss.f) != 0) failed = 1;
+
+  if (!failed && rename(tmp, path) != 0) failed = 1;     // Never leave half a snapshot
+
+  if (failed) remove(tmp);
+  free(tmp);
+
+  return (failed ? CKPT_EIO : CKPT_OK);
+}
+
+/* ========================================================================== */
+
+int ckpt_load(const char *path, struct memory *mem, struct scheduler *s, struct trace **traces)
+{
+  if (mem->vmem->pt)
+    return CKPT_EPAGETABLE;
+
+  struct snapshot ss = { fopen(path, "rb"), 0 };
+  if (ss.f == NULL)
+    return CKPT_EIO;
+
+  struct virtual_memory *vm = mem->vmem;
+  struct main_memory    *mm = mem->mmem;
+
+  int error = CKPT_OK;
+  char magic[8];
+
+  /* Header & config */
+  get(&ss, magic, 8);
+  if (ss.failed || memcmp(magic, CKPT_MAGIC, 8) != 0)
+  {
+    error = CKPT_EFORMAT;
+    goto out;
+  }
+
+  if (get_u64(&ss) != CKPT_VERSION)
+  {
+    error = CKPT_EVERSION;
+    goto out;
+  }
+
+  bool same = (get_u64(&ss) == NUM_OF_PROCESSES);
+  same = (get_u64(&ss) == vm->ipt_size) && same;
+  same = (get_u64(&ss) == vm->pg_repl)  && same;
+  same = (get_u64(&ss) == (vm->pg_repl == WS ? vm->ws->window_s : 0)) && same;
+  same = (get_u64(&ss) == vm->page_shift) && same;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    same = (get_u64(&ss) == s->procs[i].pid) && same;
+  same = same_sharing(&ss, vm->share) && same;
+
+  if (!same)
+  {
+    error = (ss.failed ? CKPT_EFORMAT : CKPT_ECONFIG);
+    goto out;
+  }
+
+  /* Memory */
+  mem->hd_reads     = get_u64(&ss);
+  mem->hd_writes    = get_u64(&ss);
+  mem->page_fs      = get_u64(&ss);
+  mem->total_req    = get_u64(&ss);
+  mem->starvations  = get_u64(&ss);
+  mem->cow_faults   = get_u64(&ss);
+  mem->shared_hits  = get_u64(&ss);
+  mem->frames_saved = get_u64(&ss);
+  mem->peak_saved   = get_u64(&ss);
+  vm->ipt_curr      = get_u64(&ss);
+
+  for (size_t i = 0; i < vm->ipt_size; ++i)
+  {
+    vm->ipt[i].set  = get_u64(&ss);
+    vm->ipt[i].pid  = get_u64(&ss);
+    vm->ipt[i].addr = get_u64(&ss);
+    vm->ipt[i].share   = get_u64(&ss);
+    vm->ipt[i].nmap    = get_u64(&ss);
+    vm->ipt[i].mappers = get_u64(&ss);
+    mm->entries[i].set      = get_u64(&ss);
+    mm->entries[i].modified = get_u64(&ss);
+    mm->entries[i].offset   = get_u64(&ss);
+    mm->entries[i].latency  = get_u64(&ss);
+  }
+
+  /* Sharing */
+  if (vm->share)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES && !ss.failed; ++i)
+    {
+      size_t n = get_u64(&ss);
+
+      for (size_t j = 0; j < n && !ss.failed; ++j)
+      {
+        if (!share_diverge(vm->share, i, get_u64(&ss)))
+        {
+          error = CKPT_ENOMEM;
+          goto out;
+        }
+      }
+    }
+  }
+
+  /* Working Set */
+  if (vm->pg_repl == WS)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES && !ss.failed; ++i)
+    {
+      size_t n = get_u64(&ss);
+
+      for (size_t j = 0; j < n && !ss.failed; ++j)
+      {
+        struct vmem_entry entry = { .set = 1 };
+        entry.pid  = get_u64(&ss);
+        entry.addr = get_u64(&ss);
+
+        if (!queue_insert_last(vm->ws->history[i], entry))
+        {
+          error = CKPT_ENOMEM;
+          goto out;
+        }
+      }
+    }
+  }
+
+  /* Scheduler */
+  s->curr         = (int) (int64_t) get_u64(&ss);
+  s->last         = (int) (int64_t) get_u64(&ss);
+  s->slice        = get_u64(&ss);
+  s->clock        = get_u64(&ss);
+  s->busy         = get_u64(&ss);
+  s->switch_t     = get_u64(&ss);
+  s->ctx_switches = get_u64(&ss);
+  s->refs         = get_u64(&ss);
+  s->lc_refs      = get_u64(&ss);
+  s->lc_faults    = get_u64(&ss);
+  s->lc_starv     = get_u64(&ss);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    struct process *p = &s->procs[i];
+
+    p->state      = get_u64(&ss);
+    p->wake       = get_u64(&ss);
+    p->refs       = get_u64(&ss);
+    p->faults     = get_u64(&ss);
+    p->dispatches = get_u64(&ss);
+    p->blocked_t  = get_u64(&ss);
+    p->finish     = get_u64(&ss);
+    p->need       = get_u64(&ss);
+    p->susp_t     = get_u64(&ss);
+
+    p->st_head  = 0;
+    p->st_count = get_u64(&ss);
+
+    if (p->st_count > SCHED_BATCH)
+    {
+      error = CKPT_EFORMAT;
+      goto out;
+    }
+
+    get(&ss, p->st_addrs, p->st_count * sizeof(uint32_t));
+    get(&ss, p->st_modes, p->st_count * sizeof(char));
+    p->ended = get_u64(&ss);
+  }
+
+  size_t n_susp = get_u64(&ss);
+  for (size_t i = 0; i < n_susp && !ss.failed; ++i)
+  {
+    struct suspension susp;
+    susp.pid   = get_u64(&ss);
+    susp.start = get_u64(&ss);
+    susp.end   = get_u64(&ss);
+    susp.freed = get_u64(&ss);
+
+    if (s->n_susp == s->susp_cap)
+    {
+      size_t cap = (s->susp_cap ? 2 * s->susp_cap : 16);
+      struct suspension *log = realloc(s->susp, cap * sizeof(struct suspension));
+
+      if (log == NULL)
+      {
+        error = CKPT_ENOMEM;
+        goto out;
+      }
+      s->susp = log;
+      s->susp_cap = cap;
+    }
+    s->susp[s->n_susp++] = susp;
+  }
+
+  /* Traces */
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    uint64_t off  = get_u64(&ss);
+    size_t   skip = get_u64(&ss);
+
+    if (ss.failed) break;
+
+    if (!traces[i] || trace_seek(traces[i], off, skip) == 0)
+    {
+      error = CKPT_ETRACE;
+      goto out;
+    }
+  }
+
+  if (ss.failed)
+    error = CKPT_EFORMAT;
+
+out:
+  fclose(ss.f);
+  return error;
+}
+
+/* ========================================================================== */
+
+void ckpt_hook(struct scheduler *s, struct memory *mem, void *arg)
+{
+  struct ckpt_target *target = arg;
+
+  int error = ckpt_save(target->path, mem, s, target->traces);
+
+  if (error != CKPT_OK && target->error == CKPT_OK)
+  {
+    target->error = error;
+    target->error_refs = s->refs;
+  }
+}
+
+/* ========================================================================== */
+
+const char *ckpt_strerror(int error)
+{
+  switch (error)
+  {
+    case CKPT_OK:       return "Success";
+    case CKPT_EIO:      return "Couldn't read/write the snapshot file";
+    case CKPT_EFORMAT:  return "Not a snapshot, or a truncated one";
+    case CKPT_EVERSION: return "Snapshot of an unsupported version";
+    case CKPT_ECONFIG:  return "Frames, algorithm, window, page size, PIDs or shared pages differ from the snapshot";
+    case CKPT_ETRACE:   return "Traces can't be repositioned (pipes, stdin or streams)";
+    case CKPT_ENOMEM:   return "Out of memory";
+    case CKPT_EPAGETABLE: return "Runs with a page table model can't be checkpointed";
+  }
+  return "Unknown error";
+}
+
+/* ========================================================================== */
+
+static void put(struct snapshot *ss, const void *v, size_t size)
+{
+  if (size && fwrite(v, size, 1, ss->f) != 1)
+    ss->failed = 1;
+}
+
+/* ========================================================================== */
+
+static void get(struct snapshot *ss, void *v, size_t size)
+{
+  if (size && fread(v, size, 1, ss->f) != 1)
+  {
+    memset(v, 0, size);
+    ss->failed = 1;
+  }
+}
+
+/* ========================================================================== */
+
+static void put_u64(struct snapshot *ss, uint64_t v)
+{
+  put(ss, &v, sizeof(v));
+}
+
+/* ========================================================================== */
+
+static uint64_t get_u64(struct snapshot *ss)
+{
+  uint64_t v;
+  get(ss, &v, sizeof(v));
+  return v;
+}
+
+/* ========================================================================== */
+
+static void put_sharing(struct snapshot *ss, struct sharing_comp *sh)
+{
+  put_u64(ss, sh ? sh->n_segs : 0);
+  for (size_t i = 0; sh && i < sh->n_segs; ++i)
+  {
+    put_u64(ss, sh->segs[i].start);
+    put_u64(ss, sh->segs[i].end);
+    put_u64(ss, sh->segs[i].mappers);
+  }
+  put_u64(ss, sh ? sh->forked : 0);
+}
+
+/* ========================================================================== */
+
+static bool same_sharing(struct snapshot *ss, struct sharing_comp *sh)
+{
+  bool same = (get_u64(ss) == (sh ? sh->n_segs : 0));
+
+  for (size_t i = 0; same && sh && i < sh->n_segs; ++i)
+  {
+    same = (get_u64(ss) == sh->segs[i].start)   && same;
+    same = (get_u64(ss) == sh->segs[i].end)     && same;
+    same = (get_u64(ss) == sh->segs[i].mappers) && same;
+  }
+  return (get_u64(ss) == (sh ? sh->forked : 0)) && same;
+}
+
+/* ========================================================================== */
\ No newline at end of file
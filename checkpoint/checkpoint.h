@@ -0,0 +1,59 @@
+/* checkpoint.h */
+#ifndef CHECKPOINT_MODULE
+#define CHECKPOINT_MODULE
+
+#include "memory.h"       // struct memory
+#include "scheduler.h"    // struct scheduler
+#include "trace.h"        // struct trace
+
+#define CKPT_MAGIC   "MEMSIMCK"
+#define CKPT_VERSION 4
+
+enum ckpt_error
+{
+  CKPT_OK,
+  CKPT_EIO,               // Couldn't read/write the snapshot file
+  CKPT_EFORMAT,           // Not a snapshot, or a truncated one
+  CKPT_EVERSION,          // Snapshot of another format version
+  CKPT_ECONFIG,           // Memory set up differently than in the snapshot
+  CKPT_ETRACE,            // Traces can't be repositioned (pipes, stdin)
+  CKPT_ENOMEM,            // Out of memory
+  CKPT_EPAGETABLE         // Page table models aren't saved
+};
+
+
+// What the scheduler hook needs to write a checkpoint
+struct ckpt_target
+{
+  const char *path;
+  struct trace **traces;          // Trace of each process
+
+  int error;                      // First failure of the hook, CKPT_OK if none
+  size_t error_refs;              // # References at which it failed
+};
+
+
+/* Writes the full state of a run: memory, IPT, Working Set windows,     *
+ * shared pages, scheduler, load control and the position in every trace. *
+ * Not for runs with a page table model (`mem_page_table()`).            *
+ * The snapshot replaces `path` atomically. Returns an `enum ckpt_error`. */
+int  ckpt_save(const char *path, struct memory *mem, struct scheduler *s, struct trace **traces);
+
+
+/* Restores a snapshot in a memory and scheduler just initialized, and    *
+ * moves every trace to where it was. The memory must be set up as in     *
+ * the snapshot; the scheduling configuration may differ (warm start).   *
+ * Returns an `enum ckpt_error`.                                          */
+int  ckpt_load(const char *path, struct memory *mem, struct scheduler *s, struct trace **traces);
+
+
+/* Scheduler hook writing a checkpoint to the `struct ckpt_target` given as `arg`. *
+ * A failure is recorded in the target, the run goes on.                         */
+void ckpt_hook(struct scheduler *s, struct memory *mem, void *arg);
+
+
+/* Returns a description of an `enum ckpt_error`. */
+const char *ckpt_strerror(int error);
+
+
+#endif
@@ -0,0 +1,207 @@
+/* memsim.c */
+#include <stddef.h>       // size_t, NULL
+#include <stdint.h>       // uint8_t, uint32_t
+
+#include "memsim.h"
+#include "memory.h"       // mem_init(), mem_page_size(), mem_page_table(), mem_clean()
+#include "scheduler.h"    // sched_*()
+#include "page_table.h"   // struct page_table
+
+/* ========================================================================== */
+
+int memsim_check(const struct memsim_config *cfg)
+{
+  if (cfg->frames == 0)
+    return MEMSIM_EINVAL;
+
+  if (cfg->alg != LRU && cfg->alg != WS)
+    return MEMSIM_EINVAL;
+
+  if (cfg->alg == WS && cfg->ws_window == 0)
+    return MEMSIM_EINVAL;
+
+  if (cfg->page_shift && !mem_page_shift_ok(cfg->page_shift))
+    return MEMSIM_EINVAL;
+
+  const struct sched_config *sc = &cfg->sched;
+
+  if (sc->policy != RR_QUANTUM && sc->policy != FAULT_SWITCH && sc->policy != PRIORITY)
+    return MEMSIM_EINVAL;
+
+  if (sc->quantum == 0 && sc->policy != FAULT_SWITCH)
+    return MEMSIM_EINVAL;
+
+  if (sc->lc_max_pf < 0 || sc->lc_max_pf > 1)
+    return MEMSIM_EINVAL;
+
+  if (sc->ckpt_every && sc->ckpt == NULL)
+    return MEMSIM_EINVAL;
+
+  if (cfg->n_segs && cfg->segs == NULL)
+    return MEMSIM_EINVAL;
+
+  for (size_t i = 0; i < cfg->n_segs; ++i)
+  {
+    if (cfg->segs[i].first > cfg->segs[i].last)
+      return MEMSIM_EINVAL;
+  }
+
+  if (cfg->page_table != PT_NONE && cfg->page_table != PT_IPT && cfg->page_table != PT_RADIX2
+      && cfg->page_table != PT_RADIX4 && cfg->page_table != PT_HASHED)
+    return MEMSIM_EINVAL;
+
+  if (cfg->page_table != PT_NONE && (cfg->n_segs || cfg->forked))
+    return MEMSIM_EINVAL;
+
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+int memsim_init(struct memsim *sim, const struct memsim_config *cfg, ref_source read_ref, void **srcs)
+{
+  sim->mem = NULL;
+  sim->sched = NULL;
+
+  int error = memsim_check(cfg);
+  if (error != MEMSIM_OK)
+    return error;
+
+  struct sched_config sc = cfg->sched;
+  uint8_t pids[NUM_OF_PROCESSES];
+  int prios[NUM_OF_PROCESSES];
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    pids[i]  = cfg->pids[i];
+    prios[i] = cfg->prios[i];
+  }
+
+  sim->mem   = mem_init(cfg->frames, cfg->alg, pids, cfg->ws_window);
+  sim->sched = sched_init(&sc, pids, prios, read_ref, srcs);
+
+  if (sim->mem == NULL || sim->sched == NULL)
+  {
+    memsim_clean(sim);
+    return MEMSIM_ENOMEM;
+  }
+
+  if (cfg->page_shift)
+    error = mem_page_size(sim->mem, cfg->page_shift);
+
+  if (cfg->page_table != PT_NONE && error == MEMSIM_OK)
+    error = mem_page_table(sim->mem, cfg->page_table);
+
+  for (size_t i = 0; i < cfg->n_segs && error == MEMSIM_OK; ++i)
+    error = mem_share(sim->mem, cfg->segs[i].first, cfg->segs[i].last, pids, NUM_OF_PROCESSES);
+
+  if (cfg->forked && error == MEMSIM_OK)
+    error = mem_fork(sim->mem, pids, NUM_OF_PROCESSES);
+
+  if (error != MEMSIM_OK)
+    memsim_clean(sim);
+
+  return error;
+}
+
+/* ========================================================================== */
+
+int memsim_run(struct memsim *sim)
+{
+  return sched_run(sim->sched, sim->mem);
+}
+
+/* ========================================================================== */
+
+void memsim_get_stats(const struct memsim *sim, struct memsim_stats *st)
+{
+  const struct memory *mem = sim->mem;
+  const struct scheduler *s = sim->sched;
+
+  st->requests    = mem->total_req;
+  st->page_fs     = mem->page_fs;
+  st->hd_reads    = mem->hd_reads;
+  st->hd_writes   = mem->hd_writes;
+  st->starvations = mem->starvations;
+
+  st->sharing      = (mem->vmem->share != NULL);
+  st->cow_faults   = mem->cow_faults;
+  st->shared_hits  = mem->shared_hits;
+  st->frames_saved = mem->frames_saved;
+  st->peak_saved   = mem->peak_saved;
+
+  const struct page_table *pt = mem->vmem->pt;
+
+  st->page_table      = (pt ? pt->kind : PT_NONE);
+  st->pt_bytes        = (pt ? pt->bytes : 0);
+  st->pt_peak_bytes   = (pt ? pt->peak_bytes : 0);
+  st->pt_translations = (pt ? pt->translations : 0);
+  st->pt_accesses     = (pt ? pt->accesses : 0);
+  st->walk_lookups    = (pt ? pt->walk_lookups : 0);
+  st->walk_hits       = (pt ? pt->walk_hits : 0);
+
+  st->policy       = s->cfg.policy;
+  st->refs         = s->refs;
+  st->clock        = s->clock;
+  st->busy         = s->busy;
+  st->switch_t     = s->switch_t;
+  st->ctx_switches = s->ctx_switches;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    const struct process *p = &s->procs[i];
+
+    st->procs[i] = (struct memsim_proc_stats)
+    {
+      .pid = p->pid, .refs = p->refs, .faults = p->faults, .dispatches = p->dispatches,
+      .blocked_t = p->blocked_t, .finish = p->finish, .susp_t = p->susp_t
+    };
+  }
+
+  st->susp   = s->susp;
+  st->n_susp = s->n_susp;
+}
+
+/* ========================================================================== */
+
+void memsim_clean(struct memsim *sim)
+{
+  if (sim->sched)
+    sched_clean(sim->sched);
+  mem_clean(sim->mem);
+
+  sim->mem = NULL;
+  sim->sched = NULL;
+}
+
+/* ========================================================================== */
+
+int memsim_array_read(void *array, uint32_t *paddr, char *pmode)
+{
+  struct memsim_array *a = array;
+
+  if (a->next == a->n)
+    return REF_END;
+
+  *paddr = a->addrs[a->next];
+  *pmode = a->modes[a->next];
+  ++a->next;
+
+  return REF_OK;
+}
+
+/* ========================================================================== */
+
+const char *memsim_strerror(int error)
+{
+  switch (error)
+  {
+    case MEMSIM_OK:     return "Success";
+    case MEMSIM_ENOMEM: return "Out of memory";
+    case MEMSIM_EINVAL: return "Invalid configuration";
+    case MEMSIM_EIO:    return "Couldn't open or read an input";
+  }
+  return "Unknown error";
+}
+
+/* ========================================================================== */
@@ -0,0 +1,143 @@
+/* memsim.h */
+#ifndef MEMSIM_LIBRARY
+#define MEMSIM_LIBRARY
+
+#include <stdbool.h>      // bool
+#include <stddef.h>       // size_t
+#include <stdint.h>       // uint8_t, uint32_t
+
+#include "memory.h"       // enum algorithm, enum memsim_error, NUM_OF_PROCESSES
+#include "scheduler.h"    // struct sched_config, ref_source, struct suspension
+
+/* libmemsim: the simulator as a library. Nothing is printed and nothing *
+ * exits: every failure is returned as an `enum memsim_error`. There is  *
+ * no global state, so any number of simulations may run side by side   *
+ * (one thread per simulation).                                          *
+ * The modules' own headers (memory.h, scheduler.h, trace.h, ...) stay   *
+ * usable for finer control, e.g. checkpoints or sampled runs.          */
+
+// Addresses [first, last] shared by every process (shared memory, libraries)
+struct memsim_segment
+{
+  uint32_t first;
+  uint32_t last;
+};
+
+
+struct memsim_config
+{
+  enum algorithm alg;             // Page replacement algorithm
+  size_t frames;
+  size_t ws_window;               // Working Set window, WS only
+  unsigned page_shift;            // Pages of 2^page_shift bytes: 12, 13, 14, 16 or 21; 0 for 4KB
+
+  uint8_t pids[NUM_OF_PROCESSES];
+  int     prios[NUM_OF_PROCESSES];
+
+  const struct memsim_segment *segs;    // Shared segments, none if NULL
+  size_t n_segs;
+  bool forked;                    // Processes forked from one parent: other pages copy-on-write
+
+  enum pt_kind page_table;        // Page table modelled, PT_NONE for none; not with sharing
+
+  struct sched_config sched;      // Zeroed: round-robin, no latency, no load control
+};
+
+
+struct memsim_proc_stats
+{
+  uint8_t pid;
+  size_t refs;                    // # References executed
+  size_t faults;
+  size_t dispatches;
+  size_t blocked_t;               // # Ticks spent waiting for the disk
+  size_t finish;                  // Tick at which its trace ended
+  size_t susp_t;                  // # Ticks spent suspended
+};
+
+
+struct memsim_stats
+{
+  size_t requests;                // # Requests to the memory
+  size_t page_fs;
+  size_t hd_reads;
+  size_t hd_writes;
+  size_t starvations;
+
+  bool   sharing;                 // Whether pages are shared, the next 4 are 0 if not
+  size_t cow_faults;              // # Writes that copied a frame another process maps
+  size_t shared_hits;             // # Faults avoided by pages in another process' frame
+  size_t frames_saved;            // # Frames sharing saves at the end of the run
+  size_t peak_saved;              // ... at most during the run
+
+  enum pt_kind page_table;        // Page table modelled, the next 6 are 0 if none
+  size_t pt_bytes;                // Page table memory in use at the end of the run
+  size_t pt_peak_bytes;           // ... at most during the run
+  size_t pt_translations;
+  size_t pt_accesses;             // # Memory accesses of the walks
+  size_t walk_lookups;            // # Walks that looked up the walk cache (radix tables)
+  size_t walk_hits;               // # Walks that skipped levels thanks to it
+
+  enum sched_policy policy;
+  size_t refs;                    // # References executed by every process
+  size_t clock;                   // Elapsed ticks
+  size_t busy;                    // # Ticks spent executing references
+  size_t switch_t;                // # Ticks spent context switching
+  size_t ctx_switches;
+
+  struct memsim_proc_stats procs[NUM_OF_PROCESSES];
+
+  const struct suspension *susp;  // Suspensions, owned by the simulation
+  size_t n_susp;
+};
+
+
+// A simulation: a memory, and the scheduler running the processes on it
+struct memsim
+{
+  struct memory *mem;
+  struct scheduler *sched;
+};
+
+
+// In-memory trace of a process, a source for `memsim_array_read()`
+struct memsim_array
+{
+  const uint32_t *addrs;
+  const char *modes;              // 'R'/'W'
+  size_t n;
+  size_t next;                    // Index of the next reference
+};
+
+
+/* Checks a configuration. Returns MEMSIM_OK or MEMSIM_EINVAL. */
+int  memsim_check(const struct memsim_config *cfg);
+
+
+/* Sets up a simulation of the processes in `cfg`, process i reading its   *
+ * references with `read_ref(srcs[i], ...)`. Returns an `enum memsim_error`. */
+int  memsim_init(struct memsim *sim, const struct memsim_config *cfg, ref_source read_ref, void **srcs);
+
+
+/* Runs the simulation until every source ends or `max_refs` is reached. *
+ * Returns an `enum memsim_error`.                                        */
+int  memsim_run(struct memsim *sim);
+
+
+/* Gets the stats of the simulation so far. */
+void memsim_get_stats(const struct memsim *sim, struct memsim_stats *st);
+
+
+/* Deallocates a simulation. Sources are owned by the caller. */
+void memsim_clean(struct memsim *sim);
+
+
+/* Reads the next reference of a `struct memsim_array` (a `ref_source`). */
+int  memsim_array_read(void *array, uint32_t *paddr, char *pmode);
+
+
+/* Returns a description of an `enum memsim_error`. */
+const char *memsim_strerror(int error);
+
+
+#endif
@@ -1,93 +1,181 @@
 /* ipt_management.c */
-#include <stdint.h>          // size_t, uint32_t, uint8_t
-#include <time.h>            // timespec, clock_gettime
+#include <stdbool.h>         // bool
+#include <stdint.h>          // size_t, uint32_t, uint8_t, uint64_t
 
 #include "ipt_management.h"
 #include "memory.h"          // enum algorithm, NUM_OF_PROCESSES
 #include "page_repl.h"       // lru(), working_set()
+#include "sharing.h"         // share_slot()
+#include "page_table.h"      // pt_translate()
 
 #define FAILED     0
 #define SUCCESSFUL 1
 
 
-// Initializes a memory entry (IPT + Main Memory) with the given values
-static void set_new_entry(struct memory *mem, size_t index, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs);
+// Returns the index of an empty IPT slot, (size_t) -1 if the IPT is full
+static size_t find_empty(struct virtual_memory *vm);
+
+// Empties an IPT slot with the page replacement algorithm, returns its index
+static size_t make_room(struct memory *mem, uint8_t pid);
 
 /* ========================================================================== */
 
 // Search for a specific reference in the IPT. If found, update fields.
-int ipt_search(struct memory *mem, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs)
+int ipt_search(struct memory *mem, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs)
+{
+  size_t i = ipt_find(mem, page, pid);
+
+  if (i == (size_t) -1)
+    return FAILED;
+
+  ipt_touch(mem, i, mode, t, ofs);
+  return SUCCESSFUL;      // Page found in the IPT and updated
+}
+
+/* ========================================================================== */
+
+size_t ipt_find(struct memory *mem, uint32_t page, uint8_t pid)
 {
   struct virtual_memory *vm = mem->vmem;
-  struct main_memory    *mm = mem->mmem;
+
+  if (vm->pt)                                      // Walk the page table
+    return pt_translate(vm, page, pid);
 
   for (size_t i = 0; i < vm->ipt_size; ++i)        // Linear IPT search
   {
     if (vm->ipt[i].set && vm->ipt[i].addr == page && vm->ipt[i].pid == pid)
-    {
-      if (mode == 'W')
-        mm->entries[i].modified = 1;          // Write operation
+      return i;
+  }
+  return (size_t) -1;
+}
+
+/* ========================================================================== */
+
+void ipt_touch(struct memory *mem, size_t index, char mode, uint64_t t, uint32_t ofs)
+{
+  struct mmem_entry *entry = &mem->mmem->entries[index];
 
-      mm->entries[i].latency = t;             // Update timestamp
-      mm->entries[i].offset  = ofs;           // Update offset
+  if (mode == 'W')
+    entry->modified = 1;          // Write operation
 
-      return SUCCESSFUL;      // Page found in the IPT and updated
-    }
-  }
-  return FAILED;
+  entry->latency = t;             // Update timestamp
+  entry->offset  = ofs;           // Update offset
 }
 
 /* ========================================================================== */
 
 // Check if a reference can fit in the IPT. If yes, place it in the IPT/MainMem.
-int ipt_fit(struct memory *mem, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs)
+size_t ipt_fit(struct memory *mem, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs)
 {
   struct virtual_memory *vm = mem->vmem;
 
-  if (vm->ipt_curr == vm->ipt_size)       // IPT full
-    return FAILED; 
+  size_t pos = find_empty(vm);
 
-  size_t pos;
+  if (pos == (size_t) -1)       // IPT full
+    return pos;
 
-  for (size_t i = 0; i < vm->ipt_size; ++i) {         
-    if (vm->ipt[i].set == 0)
-    { 
-      pos = i;          // Found an empty slot
-      break;
-    }
-  }
   set_new_entry(mem, pos, page, pid, mode, t, ofs);    // Place the new page
 
   ++vm->ipt_curr;
   
-  return SUCCESSFUL;    // Page is written to the IPT and the Main Memory
+  return pos;           // Page is written to the IPT and the Main Memory
 }
 
 /* ========================================================================== */
 
 // Place a reference in the IPT using a page replacement algorithm
-void ipt_replace_page(struct memory *mem, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs)
+size_t ipt_replace_page(struct memory *mem, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs)
 {
-  size_t empty_pos;            // Index of an empty IPT slot
-
-  if (mem->vmem->pg_repl == LRU)
-    empty_pos = lru(mem);
-
-  else if (mem->vmem->pg_repl == WS)
-    empty_pos = working_set(mem, pid);    
+  size_t empty_pos = make_room(mem, pid);      // Index of an empty IPT slot
     
   set_new_entry(mem, empty_pos, page, pid, mode, t, ofs);  // Place the new page
     
   ++mem->vmem->ipt_curr;
+
+  return empty_pos;
 }
 
 /* ========================================================================== */
 
-static void set_new_entry(struct memory *mem, size_t index, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs)
+size_t ipt_place(struct memory *mem, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs)
 {
-  mem->vmem->ipt[index] = (struct vmem_entry) { .set = 1, .addr = page, .pid = pid };          // Init the IPT entry
-  mem->mmem->entries[index] = (struct mmem_entry) { .set = 1, .offset = ofs, .latency = t };   // Init the Main Memory entry  
-  mem->mmem->entries[index].modified = (mode == 'W' ? 1 : 0);
+  size_t pos = ipt_fit(mem, page, pid, mode, t, ofs);
+
+  if (pos == (size_t) -1)
+    pos = ipt_replace_page(mem, page, pid, mode, t, ofs);
+
+  return pos;
+}
+
+/* ========================================================================== */
+
+int ipt_map(struct memory *mem, size_t index, uint8_t pid)
+{
+  struct vmem_entry *e = &mem->vmem->ipt[index];
+  uint32_t bit = 1u << share_slot(mem->vmem, pid);
+
+  if (e->mappers & bit)
+    return 0;
+
+  if (e->nmap && ++mem->frames_saved > mem->peak_saved)    // One frame for one more process
+    mem->peak_saved = mem->frames_saved;
+
+  e->mappers |= bit;
+  ++e->nmap;
+  return 1;
+}
+
+/* ========================================================================== */
+
+size_t ipt_unmap(struct memory *mem, size_t index, uint8_t pid)
+{
+  struct vmem_entry *e = &mem->vmem->ipt[index];
+  uint32_t bit = 1u << share_slot(mem->vmem, pid);
+
+  if (e->mappers & bit)
+  {
+    e->mappers &= ~bit;
+    if (--e->nmap)
+      --mem->frames_saved;
+  }
+  return e->nmap;
+}
+
+/* ========================================================================== */
+
+bool ipt_owns(struct memory *mem, size_t index, uint8_t pid)
+{
+  struct vmem_entry *e = &mem->vmem->ipt[index];
+
+  if (e->share == SHARE_NONE)
+    return (e->pid == pid);
+
+  return (e->mappers & (1u << share_slot(mem->vmem, pid))) != 0;
+}
+
+/* ========================================================================== */
+
+static size_t find_empty(struct virtual_memory *vm)
+{
+  if (vm->ipt_curr == vm->ipt_size)
+    return (size_t) -1;
+
+  for (size_t i = 0; i < vm->ipt_size; ++i)
+  {
+    if (vm->ipt[i].set == 0)
+      return i;           // Found an empty slot
+  }
+  return (size_t) -1;
+}
+
+/* ========================================================================== */
+
+static size_t make_room(struct memory *mem, uint8_t pid)
+{
+  if (mem->vmem->pg_repl == WS)
+    return working_set(mem, pid);
+
+  return lru(mem);
 }
 
 /* ========================================================================== */
\ No newline at end of file
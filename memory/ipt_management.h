@@ -2,24 +2,65 @@
 #ifndef IPT_MANAGEMENT
 #define IPT_MANAGEMENT
 
-#include <stdint.h>       // size_t, uint32_t, uint8_t
-#include <time.h>         // timespec
+#include <stdbool.h>      // bool
+#include <stdint.h>       // size_t, uint32_t, uint8_t, uint64_t
 
 #include "memory.h"
+#include "page_table.h"   // pt_map()
+
+/* Initializes the entry at `index` of the IPT/Main Memory with the given *
+ * values, and maps it in the page table if there's one. Every placement  *
+ * goes through it, the LRU batch loop of memory.c included.            */
+static inline void set_new_entry(struct memory *mem, size_t index, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs)
+{
+  mem->vmem->ipt[index] = (struct vmem_entry) { .set = 1, .addr = page, .pid = pid };          // Init the IPT entry
+  mem->mmem->entries[index] = (struct mmem_entry) { .set = 1, .modified = (mode == 'W'), .offset = ofs, .latency = t };   // Init the Main Memory entry
+
+  if (mem->vmem->pt && !pt_map(mem->vmem, index))
+    mem->error = MEMSIM_ENOMEM;
+}
+
 
 /* Search for a `page` owned by `pid` in the IPT.                  *
  * Returns 1 if such entry is found and updates the entry, else 0. */
-int  ipt_search(struct memory *, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs);
+int  ipt_search(struct memory *, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs);
+
 
+/* Returns the IPT index of `page` owned by `pid`, (size_t) -1 if it isn't there. */
+size_t ipt_find(struct memory *, uint32_t page, uint8_t pid);
 
-/* If the IPT is full, returns 0.                                                           *
- * Else, inserts the values given as an entry in the IPT and the Main Memory and returns 1. */
-int  ipt_fit   (struct memory *, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs);
+
+/* Updates the entry at `index` of the IPT/Main Memory after a reference to it. */
+void ipt_touch (struct memory *, size_t index, char mode, uint64_t t, uint32_t ofs);
+
+
+/* If the IPT is full, returns (size_t) -1. Else, inserts the values given as an *
+ * entry in the IPT and the Main Memory and returns its IPT index.               */
+size_t ipt_fit (struct memory *, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs);
 
 
 /* Creates space in the IPT by removing 1 or more pages, depending on the page replacement algorithm used. *
- * Then, stores the new entry in the *not full* IPT and Main Memory.                                       */
-void ipt_replace_page(struct memory *, uint32_t page, uint8_t pid, char mode, struct timespec t, uint16_t ofs);
+ * Then, stores the new entry in the *not full* IPT and Main Memory, and returns its IPT index.           */
+size_t ipt_replace_page(struct memory *, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs);
+
+
+/* Stores a new entry, as `ipt_fit()` or else `ipt_replace_page()` do. *
+ * Returns its IPT index.                                              */
+size_t ipt_place(struct memory *, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs);
+
+
+/* Adds `pid` to the mappers of the shared frame at `index`. *
+ * Returns 1 if it didn't map it yet, else 0.                */
+int  ipt_map  (struct memory *, size_t index, uint8_t pid);
+
+
+/* Removes `pid` from the mappers of the shared frame at `index`. *
+ * Returns the # of mappers left.                                 */
+size_t ipt_unmap(struct memory *, size_t index, uint8_t pid);
+
+
+/* Whether the frame at `index` is of process `pid`: its own, or shared and mapped by it. */
+bool ipt_owns (struct memory *, size_t index, uint8_t pid);
 
 
 #endif
\ No newline at end of file
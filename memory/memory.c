@@ -1,103 +1,198 @@
 /* memory.c */
-#include <assert.h>       // for malloc check
-#include <stdio.h>        // printf
 #include <stdbool.h>      // bool
-#include <stdint.h>       // size_t, uint32_t, uint8_t
+#include <stdint.h>       // size_t, uint32_t, uint8_t, uint64_t
 #include <stdlib.h>       // malloc, calloc, free, NULL
-#include <time.h>         // timespec, clock_gettime
 
 #include "memory.h"          // enum algorithm, NUM_OF_PROCESSES
 #include "queue.h"
-#include "page_repl.h"       // ws_update_history_window()
+#include "page_repl.h"       // ws_update_history_window(), ws_size(), evict_process()
 #include "ipt_management.h"  // ipt_*()
+#include "sharing.h"         // share_*()
+#include "page_table.h"      // pt_init(), pt_clean()
 
 #define FAILED     0
 #define SUCCESSFUL 1
 
+
+static const unsigned page_shifts[] = { 12, 13, 14, 16, 21 };    // 4KB, 8KB, 16KB, 64KB, 2MB
+
+#define NUM_OF_PAGE_SIZES (sizeof(page_shifts) / sizeof(page_shifts[0]))
+
+
+// Serves the requests one at a time through `mem_retrieve()`
+static size_t one_by_one(struct memory *mem, const uint32_t *addrs, const char *modes, const uint8_t *pids, size_t n, bool stop_on_fault);
+
+// `mem_retrieve_batch()` for LRU, with the IPT search, the update and the eviction inline
+static size_t lru_batch(struct memory *mem, const uint32_t *addrs, const char *modes, const uint8_t *pids, size_t n, bool stop_on_fault);
+
+// Slots of the processes `pids` as a bitmask, 0 if one isn't tracked
+static uint32_t slots_of(struct virtual_memory *vm, const uint8_t *pids, size_t n);
+
+// Sets up the sharing components if needed. Returns 0 if out of memory, else 1.
+static int      sharing(struct virtual_memory *vm);
+
 /* ========================================================================== */
 
-void mem_retrieve(struct memory *mem, uint32_t addr, char mode, uint8_t pid)
+int mem_retrieve(struct memory *mem, uint32_t addr, char mode, uint8_t pid)
 {
-  ++mem->total_req;
+  uint64_t t = ++mem->total_req;          // Keep the time of reference
 
-  uint16_t offset = (addr << 20) >> 20;
-  uint32_t page = addr >> 12;             // Remove offset
+  unsigned shift = mem->vmem->page_shift;
 
-  struct timespec t;
-  clock_gettime(CLOCK_MONOTONIC, &t);     // Keep the time of reference
+  uint32_t offset = addr & ((1u << shift) - 1);
+  uint32_t page = addr >> shift;          // Remove offset
 
-  if (mem->vmem->pg_repl == WS) 
-    ws_update_history_window(mem->vmem, pid, page);     // History window rolls
+  if (mem->vmem->pg_repl == WS && !ws_update_history_window(mem->vmem, pid, page))
+  {                                                     // History window rolls
+    --mem->total_req;                                   // Not simulated
+    mem->error = MEMSIM_ENOMEM;
+    return -1;
+  }
+
+  if (mem->vmem->share)                 // The frame depends on who shares the page
+    return share_retrieve(mem, page, pid, mode, t, offset);
 
   if (ipt_search(mem, page, pid, mode, t, offset) == SUCCESSFUL)  // Already in the IPT
-    return;
+    return 0;
   
   ++mem->hd_reads;          // Page not found in main memory,
   ++mem->page_fs;           // so it will be read from the HD
 
-  if (ipt_fit(mem, page, pid, mode, t, offset) == SUCCESSFUL)     // Can fit in the IPT
-    return;
+  if (ipt_fit(mem, page, pid, mode, t, offset) != (size_t) -1)   // Can fit in the IPT
+    return (mem->error ? -1 : 1);
 
   ipt_replace_page(mem, page, pid, mode, t, offset);   // IPT full, perform a page replacement algorithm
+  return (mem->error ? -1 : 1);
 }
 
 /* ========================================================================== */
 
-struct memory *mem_init(size_t frames, enum algorithm alg, uint8_t *pids, size_t ws_wnd_s)
+size_t mem_retrieve_batch(struct memory *mem, const uint32_t *addrs, const char *modes, const uint8_t *pids, size_t n, bool stop_on_fault)
 {
-  struct memory *mem = malloc(sizeof(struct memory));
-  assert(mem);
+  if (mem->vmem->share || mem->vmem->pt)    // Shared pages or a page table: every request
+    return one_by_one(mem, addrs, modes, pids, n, stop_on_fault);   // resolves its frame
+
+  if (mem->vmem->pg_repl == LRU)
+    return lru_batch(mem, addrs, modes, pids, n, stop_on_fault);
+
+  struct virtual_memory *vm = mem->vmem;
+  unsigned shift = vm->page_shift;
+  bool ws = (vm->pg_repl == WS);
+
+  size_t   hit = (size_t) -1;     // IPT index of the previous reference, if it hit
+  uint32_t prev_page = 0;
+  uint8_t  prev_pid  = 0;
 
-  mem->hd_reads = mem->hd_writes = mem->page_fs = mem->total_req = 0;
+  for (size_t k = 0; k < n; ++k)
+  {
+    uint32_t page = addrs[k] >> shift;
+    uint32_t ofs  = addrs[k] & ((1u << shift) - 1);
+    uint8_t  pid  = pids[k];
+    uint64_t t    = ++mem->total_req;
+
+    if (ws && !ws_update_history_window(vm, pid, page))
+    {                                       // History window rolls
+      --mem->total_req;
+      mem->error = MEMSIM_ENOMEM;
+      return k;
+    }
+
+    if (hit == (size_t) -1 || page != prev_page || pid != prev_pid)
+    {                                       // Not the same page again
+      hit = ipt_find(mem, page, pid);
+      prev_page = page;
+      prev_pid  = pid;
+    }
+
+    if (hit != (size_t) -1)
+    {
+      ipt_touch(mem, hit, modes[k], t, ofs);
+      continue;
+    }
+
+    ++mem->hd_reads;          // Page fault
+    ++mem->page_fs;
+
+    hit = ipt_fit(mem, page, pid, modes[k], t, ofs);      // The next references to it skip the search
+    if (hit == (size_t) -1)
+      hit = ipt_replace_page(mem, page, pid, modes[k], t, ofs);
+
+    if (stop_on_fault || mem->error)
+      return k + 1;
+  }
+
+  return n;
+}
+
+/* ========================================================================== */
+
+struct memory *mem_init(size_t frames, enum algorithm alg, uint8_t *pids, size_t ws_wnd_s)
+{
+  struct memory *mem = calloc(1, sizeof(struct memory));     // Counters start at 0
+  if (mem == NULL) return NULL;
 
   /* Set up the main memory segment */
-  mem->mmem = malloc(sizeof(struct main_memory));
-  assert(mem->mmem);
+  mem->mmem = calloc(1, sizeof(struct main_memory));
+  if (mem->mmem == NULL) goto fail;
   
   mem->mmem->entries = calloc(frames, sizeof(struct mmem_entry));
-  assert(mem->mmem->entries);
+  if (mem->mmem->entries == NULL) goto fail;
 
   mem->mmem->mm_size = frames;
 
   /* Set up the virtual memory segment */
-  mem->vmem = malloc(sizeof(struct virtual_memory));
-  assert(mem->vmem);
+  mem->vmem = calloc(1, sizeof(struct virtual_memory));
+  if (mem->vmem == NULL) goto fail;
 
   struct virtual_memory *vm = mem->vmem;
 
   vm->ipt = calloc(frames, sizeof(struct vmem_entry));    // Create the IPT
-  assert(vm->ipt);
+  if (vm->ipt == NULL) goto fail;
 
   vm->pg_repl  = alg;
   vm->ipt_size = frames;
   vm->ipt_curr = 0;
 
+  mem_page_size(mem, OFFSET_BITS);      // Default page size
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    vm->pids[i] = pids[i];
+
   if (alg == WS)            // Create the Working Set components
   {
-    vm->ws = malloc(sizeof(struct working_set_comp));  
-    assert(vm->ws);
+    vm->ws = calloc(1, sizeof(struct working_set_comp));  
+    if (vm->ws == NULL) goto fail;
 
     vm->ws->window_s = ws_wnd_s;
     vm->ws->history_index = malloc(NUM_OF_PROCESSES * sizeof(uint8_t));
-    assert(vm->ws->history_index);
+    if (vm->ws->history_index == NULL) goto fail;
 
     for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
       vm->ws->history_index[i] = pids[i];
 
     for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
       vm->ws->history[i] = queue_initialize();
+      if (vm->ws->history[i] == NULL) goto fail;
+    }
   }
 
   return mem;
+
+fail:
+  mem_clean(mem);           // Frees whatever was allocated
+  return NULL;
 }
 
 /* ========================================================================== */
 
 void mem_clean(struct memory *mem)
 {
+  if (mem == NULL) return;
+
   struct virtual_memory *vm = mem->vmem;
 
-  if (vm->pg_repl == WS)          // Deallocate Working Set components
+  if (vm && vm->ws)               // Deallocate Working Set components
   {
     free(vm->ws->history_index);
 
@@ -107,12 +202,18 @@ void mem_clean(struct memory *mem)
     free(vm->ws);
   }
 
-  free(vm->ipt);         // Deallocate the virtual memory segment
+  if (vm)
+  {
+    share_clean(vm->share);
+    pt_clean(vm->pt);
+    free(vm->ipt);       // Deallocate the virtual memory segment
+  }
   free(vm);
 
   struct main_memory *mm = mem->mmem;
 
-  free(mm->entries);     // Deallocate main memory segment
+  if (mm)
+    free(mm->entries);   // Deallocate main memory segment
   free(mm);
 
   free(mem);
@@ -120,19 +221,254 @@ void mem_clean(struct memory *mem)
 
 /* ========================================================================== */
 
-void mem_stats(struct memory *mem)
+bool mem_page_shift_ok(unsigned shift)
+{
+  for (size_t i = 0; i < NUM_OF_PAGE_SIZES; ++i)
+  {
+    if (page_shifts[i] == shift)
+      return 1;
+  }
+  return 0;
+}
+
+/* ========================================================================== */
+
+unsigned mem_page_shift_of(size_t bytes)
 {
-  char red[] = "\033[0;31m";
-  char yel[] = "\033[0;33m";
-  char cyn[] = "\033[0;36m";
-  char res[] = "\033[0m";
+  for (size_t i = 0; i < NUM_OF_PAGE_SIZES; ++i)
+  {
+    if (((size_t) 1 << page_shifts[i]) == bytes)
+      return page_shifts[i];
+  }
+  return 0;
+}
 
-  printf("> Printing simulation results!\n");
-  printf("\n%s    Page Fault Rate%s = %1.6lf\n\n", 
-    cyn, res, (double) mem->page_fs / mem->total_req );
-  
-  printf("%s    Page Faults:%s %lu\n",       red, res, mem->page_fs  );
-  printf("%s    HardDrive Reads:%s %lu\n",   yel, res, mem->hd_reads );
-  printf("%s    HardDrive Writes:%s %lu\n\n",yel, res, mem->hd_writes);
+/* ========================================================================== */
+
+int mem_page_size(struct memory *mem, unsigned shift)
+{
+  if (!mem_page_shift_ok(shift))
+    return MEMSIM_EINVAL;
+
+  mem->vmem->page_shift = shift;
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+int mem_page_table(struct memory *mem, enum pt_kind kind)
+{
+  struct virtual_memory *vm = mem->vmem;
+
+  if (kind == PT_NONE || vm->pt || vm->share)     // Shared frames map to several processes
+    return MEMSIM_EINVAL;
+
+  vm->pt = pt_init(vm, kind);
+  return (vm->pt ? MEMSIM_OK : MEMSIM_ENOMEM);
+}
+
+/* ========================================================================== */
+
+size_t mem_release(struct memory *mem, uint8_t pid)
+{
+  return evict_process(mem, pid);
+}
+
+/* ========================================================================== */
+
+int mem_share(struct memory *mem, uint32_t first, uint32_t last, const uint8_t *pids, size_t n)
+{
+  struct virtual_memory *vm = mem->vmem;
+  uint32_t mappers = slots_of(vm, pids, n);
+
+  if (first > last || mappers == 0 || vm->pt)
+    return MEMSIM_EINVAL;
+
+  if (!sharing(vm))
+    return MEMSIM_ENOMEM;
+
+  struct sharing_comp *sh = vm->share;
+  struct shared_segment *segs = realloc(sh->segs, (sh->n_segs + 1) * sizeof(struct shared_segment));
+  if (segs == NULL)
+    return MEMSIM_ENOMEM;
+
+  segs[sh->n_segs++] = (struct shared_segment)
+  {
+    .start = first >> vm->page_shift, .end = (last >> vm->page_shift) + 1, .mappers = mappers
+  };
+  sh->segs = segs;
+
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+int mem_fork(struct memory *mem, const uint8_t *pids, size_t n)
+{
+  struct virtual_memory *vm = mem->vmem;
+  uint32_t forked = slots_of(vm, pids, n);
+
+  if (forked == 0 || vm->pt)
+    return MEMSIM_EINVAL;
+
+  if (!sharing(vm))
+    return MEMSIM_ENOMEM;
+
+  vm->share->forked |= forked;
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+size_t mem_ws_size(struct memory *mem, uint8_t pid)
+{
+  if (mem->vmem->pg_repl != WS) 
+    return 0;
+
+  size_t size = ws_size(mem->vmem, pid);
+
+  if (size == (size_t) -1)
+  {
+    mem->error = MEMSIM_ENOMEM;
+    return 0;
+  }
+  return size;
+}
+
+/* ========================================================================== */
+
+size_t mem_resident(struct memory *mem, uint8_t pid)
+{
+  size_t count = 0;
+
+  for (size_t i = 0; i < mem->vmem->ipt_size; ++i)
+  {
+    if (mem->vmem->ipt[i].set && ipt_owns(mem, i, pid))
+      ++count;
+  }
+  return count;
+}
+
+/* ========================================================================== */
+
+static size_t one_by_one(struct memory *mem, const uint32_t *addrs, const char *modes, const uint8_t *pids, size_t n, bool stop_on_fault)
+{
+  for (size_t k = 0; k < n; ++k)
+  {
+    int fault = mem_retrieve(mem, addrs[k], modes[k], pids[k]);
+
+    if (fault < 0 || (fault && stop_on_fault))
+      return k + 1;
+  }
+  return n;
 }
+
+/* ========================================================================== */
+
+static size_t lru_batch(struct memory *mem, const uint32_t *addrs, const char *modes, const uint8_t *pids, size_t n, bool stop_on_fault)
+{
+  struct virtual_memory *vm = mem->vmem;
+  struct vmem_entry *ipt = vm->ipt;
+  struct mmem_entry *mm  = mem->mmem->entries;
+  const size_t frames = vm->ipt_size;
+  const unsigned shift = vm->page_shift;
+
+  size_t   hit = (size_t) -1;     // IPT index of the previous reference, if it hit
+  uint32_t prev_page = 0;
+  uint8_t  prev_pid  = 0;
+
+  for (size_t k = 0; k < n; ++k)
+  {
+    uint32_t page = addrs[k] >> shift;
+    uint32_t ofs  = addrs[k] & ((1u << shift) - 1);
+    uint8_t  pid  = pids[k];
+    uint64_t t    = ++mem->total_req;
+
+    if (hit == (size_t) -1 || page != prev_page || pid != prev_pid)
+    {                                       // Not the same page again
+      hit = (size_t) -1;
+
+      for (size_t i = 0; i < frames; ++i)   // Linear IPT search
+      {
+        if (ipt[i].addr == page && ipt[i].pid == pid && ipt[i].set)
+        {
+          hit = i;
+          break;
+        }
+      }
+      prev_page = page;
+      prev_pid  = pid;
+    }
+
+    if (hit != (size_t) -1)
+    {
+      struct mmem_entry *e = &mm[hit];
+
+      e->modified |= (modes[k] == 'W');
+      e->latency = t;
+      e->offset  = ofs;
+      continue;
+    }
+
+    ++mem->hd_reads;          // Page fault
+    ++mem->page_fs;
+
+    size_t pos = (size_t) -1;
+
+    if (vm->ipt_curr < frames)              // Fits in the IPT
+    {
+      for (size_t i = 0; i < frames && pos == (size_t) -1; ++i)
+      {
+        if (!ipt[i].set) pos = i;
+      }
+    }
+
+    if (pos == (size_t) -1)                 // IPT full, replace a page
+      pos = lru(mem);
+
+    set_new_entry(mem, pos, page, pid, modes[k], t, ofs);
+    ++vm->ipt_curr;
+    hit = pos;                              // The next references to it skip the search
+
+    if (stop_on_fault || mem->error)
+      return k + 1;
+  }
+
+  return n;
+}
+
+/* ========================================================================== */
+
+static uint32_t slots_of(struct virtual_memory *vm, const uint8_t *pids, size_t n)
+{
+  uint32_t slots = 0;
+
+  for (size_t k = 0; k < n; ++k)
+  {
+    bool tracked = 0;
+
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      if (vm->pids[i] == pids[k])
+      {
+        slots |= 1u << i;
+        tracked = 1;
+        break;
+      }
+    }
+    if (!tracked) return 0;
+  }
+  return slots;
+}
+
+/* ========================================================================== */
+
+static int sharing(struct virtual_memory *vm)
+{
+  if (vm->share == NULL)
+    vm->share = share_init();
+
+  return (vm->share != NULL);
+}
+
 /* ========================================================================== */
\ No newline at end of file
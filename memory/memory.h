@@ -2,6 +2,7 @@
 #ifndef MEMORY_MODULE
 #define MEMORY_MODULE
 
+#include <stdbool.h>    // bool
 #include <stdint.h>     // uint8_t, uint32_t, size_t
 
 #include "memory_structs.h"
@@ -10,18 +11,81 @@
 /* Initializes the memory segment and returns a pointer to it.    *
  * Requires: 1) # of frames    2) Page Replacement algrorithm     *
  * 3) Array of associated PIDs 4) Working Set window size         *
- * Note: 4th arg is ignored if not for the Working Set algorithm  */
+ * Note: 4th arg is ignored if not for the Working Set algorithm  *
+ * Returns NULL if out of memory.                                 */
 struct memory* mem_init(size_t frames, enum algorithm alg, uint8_t *pids, size_t ws_wnd_s);
 
 
 /* Requests an address from the memory, and applies `mode` operation to it. *
  * Requires: 1) ptr to memory segment 2) Address to retrieve                *
- * 3) Mode ('R'/'W') 4) PID of the process making the request               */
-void mem_retrieve(struct memory *mem, uint32_t addr, char mode, uint8_t pid);
+ * 3) Mode ('R'/'W') 4) PID of the process making the request               *
+ * Returns 1 if the request caused a page fault, else 0.                    *
+ * Returns -1 if out of memory (`mem->error` is set), the memory is then   *
+ * only fit for `mem_clean()`.                                             */
+int  mem_retrieve(struct memory *mem, uint32_t addr, char mode, uint8_t pid);
 
 
-/* Outputs stats about memory usage. */
-void mem_stats(struct memory *mem);
+/* Requests `n` addresses in order, as `mem_retrieve()` does for each one.    *
+ * Requires: Arrays of 1) Addresses 2) Modes 3) PIDs, one entry per request   *
+ * Consecutive requests to the same page don't search the IPT again.          *
+ * If `stop_on_fault`, stops right after the first request that page faults. *
+ * Also stops if out of memory (`mem->error` is set).                        *
+ * Returns the # of requests served.                                          */
+size_t mem_retrieve_batch(struct memory *mem, const uint32_t *addrs, const char *modes, const uint8_t *pids, size_t n, bool stop_on_fault);
+
+
+/* Sets the page size to 2^`shift` bytes (4KB by default). Set before the *
+ * first request. Returns MEMSIM_OK, or MEMSIM_EINVAL if that size isn't  *
+ * simulated (see `mem_page_shift_ok()`).                                 */
+int  mem_page_size(struct memory *mem, unsigned shift);
+
+
+/* Returns 1 if pages of 2^`shift` bytes are simulated (4KB, 8KB, 16KB, 64KB, 2MB), else 0. */
+bool mem_page_shift_ok(unsigned shift);
+
+
+/* Returns the # offset bits of pages of `bytes`, 0 if that size isn't simulated. */
+unsigned mem_page_shift_of(size_t bytes);
+
+
+/* Finds the frames through a page table of organisation `kind`, which counts  *
+ * its memory, and the accesses of every walk. Pages keep the frames the IPT  *
+ * and the replacement algorithm give them. Set after the page size, before   *
+ * the first request; not with shared pages.                                  *
+ * Returns MEMSIM_OK, MEMSIM_EINVAL, or MEMSIM_ENOMEM.                        */
+int  mem_page_table(struct memory *mem, enum pt_kind kind);
+
+
+/* Releases every frame owned by process `pid`, writing modified pages to the HD. *
+ * Shared frames are only released by the last process mapping them.             *
+ * Returns the number of frames released.                                         */
+size_t mem_release(struct memory *mem, uint8_t pid);
+
+
+/* Declares the pages of addresses [first, last] shared by the processes  *
+ * `pids` (shared memory, libraries): each takes one frame for all of     *
+ * them, reads and writes alike. Declare before the first request.        *
+ * Returns MEMSIM_OK, MEMSIM_EINVAL (untracked PID, or a page table set), *
+ * or MEMSIM_ENOMEM.                                                      */
+int  mem_share(struct memory *mem, uint32_t first, uint32_t last, const uint8_t *pids, size_t n);
+
+
+/* Declares the processes `pids` forked from one parent. Their pages out of *
+ * the shared segments take one frame for all of them (copy-on-write), and *
+ * a write to one gives the writer a private copy.                         *
+ * Declare before the first request.                                      *
+ * Returns MEMSIM_OK, MEMSIM_EINVAL (untracked PID, or a page table set),  *
+ * or MEMSIM_ENOMEM.                                                       */
+int  mem_fork(struct memory *mem, const uint8_t *pids, size_t n);
+
+
+/* Returns the # of distinct pages in the History Window of process `pid`. *
+ * Note: Always 0 if not for the Working Set algorithm, or out of memory   */
+size_t mem_ws_size(struct memory *mem, uint8_t pid);
+
+
+/* Returns the # of frames process `pid` holds: its own, and shared ones it maps. */
+size_t mem_resident(struct memory *mem, uint8_t pid);
 
 
 /* Deallocates space used for the memory segment */
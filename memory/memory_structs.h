@@ -3,19 +3,48 @@
 #define MEMORY_STRUCTS
 
 #include <stdbool.h>    // bool
-#include <stdint.h>     // uint8_t, uint32_t, size_t
-#include <time.h>       // struct timespec
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint8_t, uint32_t, uint64_t
 
 #define NUM_OF_PROCESSES 2
 
+#define OFFSET_BITS 12                            // 4KB pages, by default
+#define OFFSET_MASK ((1u << OFFSET_BITS) - 1)
+
 enum algorithm { LRU, WS };     // Page replacement algorithm
 
+enum share_kind                 // Whose frame a page is in
+{
+  SHARE_NONE,                   // The process' own
+  SHARE_SEGMENT,                // One frame for the processes of a shared segment
+  SHARE_COW                     // One frame for forked processes, until one writes it
+};
+
+enum pt_kind                    // Page table organisation modelled (see page_table.h)
+{
+  PT_NONE,                      // None: the IPT is searched linearly, walks aren't counted
+  PT_IPT,                       // Inverted, hash anchored
+  PT_RADIX2,                    // 2-level radix
+  PT_RADIX4,                    // 4-level radix
+  PT_HASHED                     // Clustered hashed
+};
+
+enum memsim_error               // Errors returned by the simulator's modules
+{
+  MEMSIM_OK,
+  MEMSIM_ENOMEM,                // An allocation failed, the run can't go on
+  MEMSIM_EINVAL,                // Invalid configuration
+  MEMSIM_EIO                    // An input couldn't be opened or read
+};
+
 struct memory;
 struct main_memory;
 struct virtual_memory;
 struct mmem_entry;
 struct vmem_entry;          
-struct working_set_comp;    // Forward Declarations
+struct working_set_comp;
+struct sharing_comp;
+struct page_table;          // Forward Declarations
 
 
 // Memory segment
@@ -27,7 +56,15 @@ struct memory
   size_t hd_reads;            // # Hard Disk Reads/Writes
   size_t hd_writes;
   size_t page_fs;             // # Page Faults
-  size_t total_req;           // # Requests to the virtual memory
+  size_t total_req;           // # Requests to the virtual memory, also the logical time
+  size_t starvations;         // # Faults of a process that owned no frames (WS)
+
+  size_t cow_faults;          // # Writes that copied a frame another process maps
+  size_t shared_hits;         // # Faults avoided: a page found in another process' frame
+  size_t frames_saved;        // # Frames more the resident pages would take unshared
+  size_t peak_saved;          // Highest `frames_saved`
+
+  int error;                  // MEMSIM_ENOMEM once an allocation failed, else MEMSIM_OK
 };
 
 
@@ -47,8 +84,12 @@ struct virtual_memory
   size_t ipt_curr;               //  # occupied frames
 
   enum algorithm pg_repl;       // Page Replacement Algorithm
+  unsigned page_shift;           // # Offset bits of a page
+  uint8_t pids[NUM_OF_PROCESSES];   // Slot of each process, e.g. bit i of `mappers`
 
   struct working_set_comp *ws;   // Working Set tools
+  struct sharing_comp *share;    // Shared pages, NULL if every page is private
+  struct page_table *pt;         // Page table finding the frames, NULL to search the IPT
 };
 
 
@@ -57,8 +98,8 @@ struct mmem_entry
 {
   bool set; 
   bool modified;
-  uint16_t offset;
-  struct timespec latency;        // Time of last reference
+  uint32_t offset;                // Up to 2MB pages
+  uint64_t latency;               // Logical time of last reference
 };
 
 
@@ -66,8 +107,39 @@ struct mmem_entry
 struct vmem_entry        
 {
   bool set;
-  uint8_t  pid;           // Process that owns the page
+  uint8_t  pid;           // Process that owns the page (that read it in, if shared)
+  uint8_t  share;         // enum share_kind
+  uint8_t  nmap;          // # Processes mapping a shared page (reference count)
   uint32_t addr;          // Page address
+  uint32_t mappers;       // Slots of the processes mapping it, bit i for the i-th PID
+};                        // 12 bytes, scanned on every lookup
+
+
+// Pages of addresses [start, end) shared by some processes
+struct shared_segment
+{
+  uint32_t start;                 // First page
+  uint32_t end;                   // Page past the last one
+  uint32_t mappers;               // Slots of the processes sharing it
+};
+
+
+// Set of pages, open addressing
+struct page_set
+{
+  uint32_t *keys;                 // Page + 1, 0 if the slot is free
+  size_t size;                    // # Slots, a power of 2
+  size_t count;
+};
+
+
+struct sharing_comp
+{
+  struct shared_segment *segs;
+  size_t n_segs;
+
+  uint32_t forked;                // Slots of the processes forked from one parent
+  struct page_set diverged[NUM_OF_PROCESSES];   // Pages each one wrote, so owns a copy of
 };
 
 
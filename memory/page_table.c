@@ -0,0 +1,531 @@
+/* page_table.c */
+#include <stdint.h>          // size_t, uint32_t, uint8_t, uint64_t
+#include <stdlib.h>          // calloc, free, NULL
+
+#include "page_table.h"
+#include "memory.h"          // struct virtual_memory, enum pt_kind
+
+
+// Slot of process `pid`, as in `vmem->pids`
+static size_t slot_of(struct page_table *pt, uint8_t pid);
+
+// Bucket (IPT: hash anchor) of `key` of process `pid`
+static size_t hash(struct page_table *pt, uint8_t pid, uint32_t key);
+
+// # Index bits of the levels from `depth` down, i.e. how far `page` shifts to index a table at `depth`
+static unsigned below(struct page_table *pt, unsigned depth);
+
+// Allocates a radix table at `depth`, and accounts for it. Returns NULL if out of memory.
+static struct radix_node *radix_new(struct page_table *pt, unsigned depth);
+
+// Deallocates the radix table `node` at `depth`, and its tables below
+static void   radix_free(struct page_table *pt, struct radix_node *node, unsigned depth);
+
+// Deallocates the empty radix table `node` at `depth` (> 0), and forgets it in the walk cache
+static void   radix_drop(struct page_table *pt, struct radix_node *node, unsigned depth);
+
+// Walk of a radix table, starting from the deepest table the walk cache knows
+static size_t radix_walk(struct page_table *pt, uint32_t page, uint8_t pid);
+
+// Walk cache entry of `key`, NULL if not cached
+static struct walk_entry *cache_find(struct page_table *pt, uint64_t key);
+
+// Caches the radix table of `key`, in place of the LRU entry
+static void   cache_put(struct page_table *pt, uint64_t key, struct radix_node *node);
+
+// Walk cache key of the radix table at `depth` (> 0) that maps `page` of process `slot`
+static uint64_t cache_key(struct page_table *pt, size_t slot, unsigned depth, uint32_t page);
+
+// Node of the hashed table mapping `page` of `pid`, NULL if none
+static struct cluster_node *cluster_find(struct page_table *pt, uint8_t pid, uint32_t page, uint64_t *accesses);
+
+// Adds `bytes` of page table memory in use
+static void   grow(struct page_table *pt, size_t bytes);
+
+/* ========================================================================== */
+
+struct page_table *pt_init(struct virtual_memory *vm, enum pt_kind kind)
+{
+  struct page_table *pt = calloc(1, sizeof(struct page_table));   // Counters start at 0
+  if (pt == NULL) return NULL;
+
+  pt->kind = kind;
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    pt->pids[i] = vm->pids[i];
+
+  pt->n_buckets = 2;                // At least one per frame
+  pt->hash_shift = 63;
+  while (pt->n_buckets < vm->ipt_size)
+  {
+    pt->n_buckets *= 2;
+    --pt->hash_shift;
+  }
+
+  switch (kind)
+  {
+    case PT_IPT:
+      pt->anchor = calloc(pt->n_buckets, sizeof(uint32_t));
+      pt->chain  = calloc(vm->ipt_size, sizeof(uint32_t));
+      if (pt->anchor == NULL || pt->chain == NULL) goto fail;
+
+      grow(pt, pt->n_buckets * PT_ANCHOR_BYTES + vm->ipt_size * PT_IPT_BYTES);
+      break;
+
+    case PT_RADIX2:
+    case PT_RADIX4:
+    {
+      pt->levels = (kind == PT_RADIX2 ? 2 : 4);
+      unsigned vpn = (kind == PT_RADIX2 ? PT_RADIX2_VA : PT_RADIX4_VA) - vm->page_shift;
+
+      for (unsigned d = 0; d < pt->levels; ++d)     // Upper levels take the spare bits
+        pt->bits[d] = vpn / pt->levels + (d < vpn % pt->levels);
+
+      for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+      {
+        pt->roots[i] = radix_new(pt, 0);
+        if (pt->roots[i] == NULL) goto fail;
+      }
+      break;
+    }
+
+    case PT_HASHED:
+      pt->buckets = calloc(pt->n_buckets, sizeof(struct cluster_node *));
+      if (pt->buckets == NULL) goto fail;
+
+      grow(pt, pt->n_buckets * PT_BUCKET_BYTES);
+      break;
+
+    default:
+      goto fail;
+  }
+
+  return pt;
+
+fail:
+  pt_clean(pt);
+  return NULL;
+}
+
+/* ========================================================================== */
+
+size_t pt_translate(struct virtual_memory *vm, uint32_t page, uint8_t pid)
+{
+  struct page_table *pt = vm->pt;
+
+  ++pt->translations;
+
+  switch (pt->kind)
+  {
+    case PT_IPT:
+    {
+      ++pt->accesses;               // Hash anchor
+      for (uint32_t i = pt->anchor[hash(pt, pid, page)]; i; i = pt->chain[i - 1])
+      {
+        ++pt->accesses;             // Inverted entry
+        if (vm->ipt[i - 1].addr == page && vm->ipt[i - 1].pid == pid)
+          return i - 1;
+      }
+      return (size_t) -1;
+    }
+
+    case PT_RADIX2:
+    case PT_RADIX4:
+      return radix_walk(pt, page, pid);
+
+    case PT_HASHED:
+    {
+      struct cluster_node *node = cluster_find(pt, pid, page, &pt->accesses);
+
+      if (node == NULL || node->frame[page % PT_CLUSTER] == 0)
+        return (size_t) -1;
+      return node->frame[page % PT_CLUSTER] - 1;
+    }
+
+    default:
+      return (size_t) -1;
+  }
+}
+
+/* ========================================================================== */
+
+int pt_map(struct virtual_memory *vm, size_t index)
+{
+  struct page_table *pt = vm->pt;
+  uint32_t page = vm->ipt[index].addr;
+  uint8_t  pid  = vm->ipt[index].pid;
+
+  switch (pt->kind)
+  {
+    case PT_IPT:
+    {
+      uint32_t *head = &pt->anchor[hash(pt, pid, page)];
+
+      pt->chain[index] = *head;     // Push on the chain
+      *head = index + 1;
+      return 1;
+    }
+
+    case PT_RADIX2:
+    case PT_RADIX4:
+    {
+      struct radix_node *node = pt->roots[slot_of(pt, pid)];
+
+      for (unsigned d = 0; d + 1 < pt->levels; ++d)
+      {
+        size_t i = (page >> below(pt, d + 1)) & ((1u << pt->bits[d]) - 1);
+
+        if (node->child[i] == NULL)
+        {
+          node->child[i] = radix_new(pt, d + 1);
+          if (node->child[i] == NULL) return 0;
+          ++node->used;
+        }
+        node = node->child[i];
+      }
+
+      uint32_t *pte = &node->frame[page & ((1u << pt->bits[pt->levels - 1]) - 1)];
+
+      node->used += (*pte == 0);
+      *pte = index + 1;
+      return 1;
+    }
+
+    case PT_HASHED:
+    {
+      uint64_t ignored = 0;
+      struct cluster_node *node = cluster_find(pt, pid, page, &ignored);
+
+      if (node == NULL)
+      {
+        node = calloc(1, sizeof(struct cluster_node));
+        if (node == NULL) return 0;
+
+        size_t b = hash(pt, pid, page / PT_CLUSTER);
+
+        node->tag  = ((uint64_t) pid << 32) | (page / PT_CLUSTER);
+        node->next = pt->buckets[b];
+        pt->buckets[b] = node;
+        grow(pt, PT_NODE_BYTES);
+      }
+      node->frame[page % PT_CLUSTER] = index + 1;
+      ++node->used;
+      return 1;
+    }
+
+    default:
+      return 1;
+  }
+}
+
+/* ========================================================================== */
+
+void pt_unmap(struct virtual_memory *vm, size_t index)
+{
+  struct page_table *pt = vm->pt;
+  uint32_t page = vm->ipt[index].addr;
+  uint8_t  pid  = vm->ipt[index].pid;
+
+  switch (pt->kind)
+  {
+    case PT_IPT:
+    {
+      uint32_t *link = &pt->anchor[hash(pt, pid, page)];
+
+      while (*link && *link != index + 1)
+        link = &pt->chain[*link - 1];
+
+      if (*link)
+        *link = pt->chain[index];   // Unlink from the chain
+      break;
+    }
+
+    case PT_RADIX2:
+    case PT_RADIX4:
+    {
+      struct radix_node *path[PT_MAX_LEVELS];     // Table at each depth
+      size_t entry[PT_MAX_LEVELS];                // Entry of the page in it
+
+      path[0] = pt->roots[slot_of(pt, pid)];
+      for (unsigned d = 0; d + 1 < pt->levels; ++d)
+      {
+        entry[d] = (page >> below(pt, d + 1)) & ((1u << pt->bits[d]) - 1);
+        path[d + 1] = path[d]->child[entry[d]];
+        if (path[d + 1] == NULL) return;
+      }
+
+      unsigned d = pt->levels - 1;
+      uint32_t *pte = &path[d]->frame[page & ((1u << pt->bits[d]) - 1)];
+
+      if (*pte == 0) break;
+      *pte = 0;
+      --path[d]->used;
+
+      for (; d > 0 && path[d]->used == 0; --d)    // Free the tables left empty, not the root
+      {
+        radix_drop(pt, path[d], d);
+        path[d - 1]->child[entry[d - 1]] = NULL;
+        --path[d - 1]->used;
+      }
+      break;
+    }
+
+    case PT_HASHED:
+    {
+      struct cluster_node **link = &pt->buckets[hash(pt, pid, page / PT_CLUSTER)];
+      uint64_t tag = ((uint64_t) pid << 32) | (page / PT_CLUSTER);
+
+      while (*link && (*link)->tag != tag)
+        link = &(*link)->next;
+
+      struct cluster_node *node = *link;
+
+      if (node == NULL || node->frame[page % PT_CLUSTER] == 0)
+        break;
+
+      node->frame[page % PT_CLUSTER] = 0;
+      if (--node->used == 0)        // Maps no page, free it
+      {
+        *link = node->next;
+        free(node);
+        pt->bytes -= PT_NODE_BYTES;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+/* ========================================================================== */
+
+void pt_clean(struct page_table *pt)
+{
+  if (pt == NULL) return;
+
+  free(pt->anchor);
+  free(pt->chain);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    radix_free(pt, pt->roots[i], 0);
+
+  for (size_t b = 0; pt->buckets && b < pt->n_buckets; ++b)
+  {
+    while (pt->buckets[b])
+    {
+      struct cluster_node *next = pt->buckets[b]->next;
+      free(pt->buckets[b]);
+      pt->buckets[b] = next;
+    }
+  }
+  free(pt->buckets);
+
+  free(pt);
+}
+
+/* ========================================================================== */
+
+const char *pt_name(enum pt_kind kind)
+{
+  switch (kind)
+  {
+    case PT_IPT:    return "inverted";
+    case PT_RADIX2: return "2-level radix";
+    case PT_RADIX4: return "4-level radix";
+    case PT_HASHED: return "clustered hashed";
+    default:        return "none";
+  }
+}
+
+/* ========================================================================== */
+
+static size_t slot_of(struct page_table *pt, uint8_t pid)
+{
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (pt->pids[i] == pid)
+      return i;
+  }
+  return 0;       // Untracked PID, as with the History Windows
+}
+
+/* ========================================================================== */
+
+static size_t hash(struct page_table *pt, uint8_t pid, uint32_t key)
+{
+  uint64_t x = ((uint64_t) pid << 32) | key;
+
+  return (x * 0x9E3779B97F4A7C15ull) >> pt->hash_shift;     // Fibonacci hashing
+}
+
+/* ========================================================================== */
+
+static unsigned below(struct page_table *pt, unsigned depth)
+{
+  unsigned bits = 0;
+
+  for (unsigned d = depth; d < pt->levels; ++d)
+    bits += pt->bits[d];
+
+  return bits;
+}
+
+/* ========================================================================== */
+
+static struct radix_node *radix_new(struct page_table *pt, unsigned depth)
+{
+  size_t entries = (size_t) 1 << pt->bits[depth];
+
+  struct radix_node *node = calloc(1, sizeof(struct radix_node));
+  if (node == NULL) return NULL;
+
+  if (depth + 1 < pt->levels)
+    node->child = calloc(entries, sizeof(struct radix_node *));
+  else
+    node->frame = calloc(entries, sizeof(uint32_t));
+
+  if (node->child == NULL && node->frame == NULL)
+  {
+    free(node);
+    return NULL;
+  }
+
+  grow(pt, entries * PT_PTE_BYTES);
+  return node;
+}
+
+/* ========================================================================== */
+
+static void radix_free(struct page_table *pt, struct radix_node *node, unsigned depth)
+{
+  if (node == NULL) return;
+
+  if (node->child)
+  {
+    for (size_t i = 0; i < ((size_t) 1 << pt->bits[depth]); ++i)
+      radix_free(pt, node->child[i], depth + 1);
+  }
+
+  free(node->child);
+  free(node->frame);
+  free(node);
+}
+
+/* ========================================================================== */
+
+static void radix_drop(struct page_table *pt, struct radix_node *node, unsigned depth)
+{
+  for (size_t i = 0; i < PT_WALK_CACHE; ++i)
+  {
+    if (pt->cache[i].node == node)
+      pt->cache[i].key = 0;         // Free the entry, its table is gone
+  }
+
+  pt->bytes -= ((size_t) 1 << pt->bits[depth]) * PT_PTE_BYTES;
+  radix_free(pt, node, depth);
+}
+
+/* ========================================================================== */
+
+static size_t radix_walk(struct page_table *pt, uint32_t page, uint8_t pid)
+{
+  size_t slot = slot_of(pt, pid);
+
+  struct radix_node *node = pt->roots[slot];
+  unsigned depth = 0;
+
+  ++pt->walk_lookups;
+  for (unsigned d = pt->levels - 1; d > 0; --d)     // Deepest table known first
+  {
+    struct walk_entry *e = cache_find(pt, cache_key(pt, slot, d, page));
+
+    if (e)
+    {
+      e->stamp = ++pt->clock;
+      node  = e->node;
+      depth = d;
+      ++pt->walk_hits;
+      break;
+    }
+  }
+
+  for (unsigned d = depth; d + 1 < pt->levels; ++d)
+  {
+    ++pt->accesses;               // Entry of the table at depth `d`
+    node = node->child[(page >> below(pt, d + 1)) & ((1u << pt->bits[d]) - 1)];
+
+    if (node == NULL)             // No table below, not mapped
+      return (size_t) -1;
+
+    cache_put(pt, cache_key(pt, slot, d + 1, page), node);
+  }
+
+  ++pt->accesses;                 // PTE
+  uint32_t frame = node->frame[page & ((1u << pt->bits[pt->levels - 1]) - 1)];
+
+  return (frame ? frame - 1 : (size_t) -1);
+}
+
+/* ========================================================================== */
+
+static struct walk_entry *cache_find(struct page_table *pt, uint64_t key)
+{
+  for (size_t i = 0; i < PT_WALK_CACHE; ++i)
+  {
+    if (pt->cache[i].key == key)
+      return &pt->cache[i];
+  }
+  return NULL;
+}
+
+/* ========================================================================== */
+
+static void cache_put(struct page_table *pt, uint64_t key, struct radix_node *node)
+{
+  struct walk_entry *victim = &pt->cache[0];
+
+  for (size_t i = 1; i < PT_WALK_CACHE && victim->key; ++i)
+  {
+    if (pt->cache[i].key == 0 || pt->cache[i].stamp < victim->stamp)
+      victim = &pt->cache[i];       // Free, or used least recently
+  }
+
+  *victim = (struct walk_entry) { .key = key, .stamp = ++pt->clock, .node = node };
+}
+
+/* ========================================================================== */
+
+static uint64_t cache_key(struct page_table *pt, size_t slot, unsigned depth, uint32_t page)
+{
+  uint64_t prefix = page >> below(pt, depth);       // Indexes of the tables above
+
+  return ((uint64_t) (slot * PT_MAX_LEVELS + depth) << 40) | prefix;    // Never 0, as depth > 0
+}
+
+/* ========================================================================== */
+
+static struct cluster_node *cluster_find(struct page_table *pt, uint8_t pid, uint32_t page, uint64_t *accesses)
+{
+  uint64_t tag = ((uint64_t) pid << 32) | (page / PT_CLUSTER);
+
+  ++*accesses;                      // Bucket
+  for (struct cluster_node *node = pt->buckets[hash(pt, pid, page / PT_CLUSTER)]; node; node = node->next)
+  {
+    ++*accesses;                    // Node
+    if (node->tag == tag)
+      return node;
+  }
+  return NULL;
+}
+
+/* ========================================================================== */
+
+static void grow(struct page_table *pt, size_t bytes)
+{
+  pt->bytes += bytes;
+
+  if (pt->bytes > pt->peak_bytes)
+    pt->peak_bytes = pt->bytes;
+}
+
+/* ========================================================================== */
@@ -0,0 +1,112 @@
+/* page_table.h */
+#ifndef PAGE_TABLE_MODULE
+#define PAGE_TABLE_MODULE
+
+#include <stdint.h>       // size_t, uint8_t, uint32_t, uint64_t
+
+#include "memory.h"       // struct virtual_memory, enum pt_kind, NUM_OF_PROCESSES
+
+#define PT_MAX_LEVELS    4
+#define PT_RADIX2_VA     32       // Virtual address bits of the 2-level table
+#define PT_RADIX4_VA     48       // ... of the 4-level table, as x86-64
+#define PT_CLUSTER       16       // Pages per node of the clustered hashed table
+#define PT_WALK_CACHE    32       // Entries of the walk cache (radix tables' upper levels)
+
+#define PT_PTE_BYTES     8        // Sizes of the structures modelled, as in hardware:
+#define PT_IPT_BYTES     16       //   Inverted entry: PID, page, chain
+#define PT_ANCHOR_BYTES  4        //   Hash anchor (first inverted entry of a chain)
+#define PT_BUCKET_BYTES  8        //   Hashed table bucket (first node of a chain)
+#define PT_NODE_BYTES    (16 + PT_CLUSTER * PT_PTE_BYTES)     // Cluster node: tag, next, PTEs
+
+/* Page table organisations, each answering which frame holds a page:       *
+ * PT_IPT     Inverted table with a hash anchor table, one entry per frame  *
+ * PT_RADIX2  2-level radix table per process, on a 32-bit address space    *
+ * PT_RADIX4  4-level radix table per process, on a 48-bit address space    *
+ * PT_HASHED  Clustered hashed table: a node maps PT_CLUSTER pages in a row *
+ * A translation counts the memory accesses of its walk. Radix tables below *
+ * the root and hashed nodes are freed once they map no page. The walk      *
+ * cache keeps pointers to radix tables below the root, LRU.                */
+
+// Table of a radix level
+struct radix_node
+{
+  struct radix_node **child;      // Tables of the next level, NULL at the last level
+  uint32_t *frame;                // Frame + 1 of each page, 0 if not resident; last level only
+  size_t used;                    // # Tables below, or # pages resident
+};
+
+
+// Cached pointer to the radix table that a walk reaches at some depth
+struct walk_entry
+{
+  uint64_t key;                   // Process, depth and address prefix, 0 if free
+  uint64_t stamp;                 // Logical time of last use
+  struct radix_node *node;
+};
+
+
+// Node of the clustered hashed table
+struct cluster_node
+{
+  uint64_t tag;                   // PID and page / PT_CLUSTER
+  uint32_t frame[PT_CLUSTER];     // Frame + 1 of each page, 0 if not resident
+  size_t used;                    // # Pages mapped
+  struct cluster_node *next;
+};
+
+
+struct page_table
+{
+  enum pt_kind kind;
+  uint8_t pids[NUM_OF_PROCESSES];   // Process of each radix root
+
+  unsigned levels;                // Radix: # levels, and index bits of each, root first
+  unsigned bits[PT_MAX_LEVELS];
+  struct radix_node *roots[NUM_OF_PROCESSES];
+
+  struct walk_entry cache[PT_WALK_CACHE];
+  uint64_t clock;
+
+  size_t n_buckets;               // IPT: # hash anchors; Hashed: # buckets. A power of 2
+  unsigned hash_shift;
+  uint32_t *anchor;               // IPT: first frame + 1 of each chain, 0 if empty
+  uint32_t *chain;                // IPT: next frame + 1 of each frame's chain
+  struct cluster_node **buckets;  // Hashed
+
+  size_t bytes;                   // Page table memory in use
+  size_t peak_bytes;
+
+  uint64_t translations;
+  uint64_t accesses;              // # Memory accesses of every walk
+  uint64_t walk_lookups;          // # Walks that looked up the walk cache (radix)
+  uint64_t walk_hits;             // # Walks that skipped levels thanks to it
+};
+
+
+/* Allocates a page table of organisation `kind` for the frames, page size  *
+ * and processes of `vm`, nothing mapped. Returns NULL if out of memory.    */
+struct page_table *pt_init(struct virtual_memory *vm, enum pt_kind kind);
+
+
+/* Walks the page table for `page` of process `pid`.                 *
+ * Returns the IPT index of its frame, (size_t) -1 if not resident. */
+size_t pt_translate(struct virtual_memory *vm, uint32_t page, uint8_t pid);
+
+
+/* Maps the page of IPT entry `index` to its frame. Returns 0 if out of memory, else 1. */
+int  pt_map(struct virtual_memory *vm, size_t index);
+
+
+/* Unmaps the page of IPT entry `index`, still set. */
+void pt_unmap(struct virtual_memory *vm, size_t index);
+
+
+/* Deallocates a page table. */
+void pt_clean(struct page_table *pt);
+
+
+/* Returns the name of a page table organisation. */
+const char *pt_name(enum pt_kind kind);
+
+
+#endif
@@ -0,0 +1,234 @@
+/* sharing.c */
+#include <stdbool.h>         // bool
+#include <stdint.h>          // size_t, uint32_t, uint8_t, uint64_t
+#include <stdlib.h>          // calloc, free, NULL
+
+#include "sharing.h"
+#include "memory.h"          // enum share_kind, struct sharing_comp
+#include "ipt_management.h"  // ipt_touch(), ipt_place(), ipt_map(), ipt_unmap()
+
+#define SET_SIZE 1024        // Initial # slots of a page set
+
+
+// Kind of frame that `page` of the process in `slot` is in
+static enum share_kind kind_of(struct sharing_comp *sh, size_t slot, uint32_t page);
+
+// IPT index of `page` in a frame of that kind (owned by `pid` if private), (size_t) -1 if it isn't there
+static size_t find_frame(struct virtual_memory *vm, uint32_t page, uint8_t pid, enum share_kind kind);
+
+// A write of `pid` to the copy-on-write frame at `index`. Returns 0, or -1 if out of memory.
+static int    copy_on_write(struct memory *mem, size_t index, uint32_t page, uint8_t pid, uint64_t t, uint32_t ofs);
+
+// Whether `page` is in the set
+static bool   set_has(struct page_set *set, uint32_t page);
+
+// Slot of `page` in a set with slots: where it is, or the free one it goes to
+static uint32_t *set_slot(struct page_set *set, uint32_t page);
+
+// Doubles the slots of a set. Returns 0 if out of memory, else 1.
+static int    set_grow(struct page_set *set);
+
+/* ========================================================================== */
+
+struct sharing_comp *share_init(void)
+{
+  return calloc(1, sizeof(struct sharing_comp));      // Sets allocated on their 1st page
+}
+
+/* ========================================================================== */
+
+size_t share_slot(struct virtual_memory *vm, uint8_t pid)
+{
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (vm->pids[i] == pid)
+      return i;
+  }
+  return 0;       // Untracked PID, as with the History Windows
+}
+
+/* ========================================================================== */
+
+int share_diverge(struct sharing_comp *sh, size_t slot, uint32_t page)
+{
+  struct page_set *set = &sh->diverged[slot];
+
+  if ((set->count + 1) * 2 > set->size && !set_grow(set))    // At most half full
+    return 0;
+
+  uint32_t *key = set_slot(set, page);
+  if (*key == 0)
+  {
+    *key = page + 1;
+    ++set->count;
+  }
+  return 1;
+}
+
+/* ========================================================================== */
+
+int share_retrieve(struct memory *mem, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs)
+{
+  struct virtual_memory *vm = mem->vmem;
+  struct sharing_comp *sh = vm->share;
+
+  size_t slot = share_slot(vm, pid);
+  enum share_kind kind = kind_of(sh, slot, page);
+
+  size_t i = find_frame(vm, page, pid, kind);
+
+  if (i != (size_t) -1)
+  {
+    if (kind == SHARE_COW && mode == 'W')
+      return copy_on_write(mem, i, page, pid, t, ofs);
+
+    if (kind != SHARE_NONE && ipt_map(mem, i, pid))
+      ++mem->shared_hits;         // Another process read it in
+
+    ipt_touch(mem, i, mode, t, ofs);
+    return 0;
+  }
+
+  ++mem->hd_reads;          // Page fault
+  ++mem->page_fs;
+
+  if (kind == SHARE_COW && mode == 'W')
+  {                         // Read straight into a private copy, nothing to copy from
+    if (!share_diverge(sh, slot, page))
+    {
+      mem->error = MEMSIM_ENOMEM;
+      return -1;
+    }
+    kind = SHARE_NONE;
+  }
+
+  i = ipt_place(mem, page, pid, mode, t, ofs);
+  if (mem->error) return -1;
+
+  if (kind != SHARE_NONE)
+  {
+    vm->ipt[i].share = kind;
+    ipt_map(mem, i, pid);
+  }
+  return 1;
+}
+
+/* ========================================================================== */
+
+void share_clean(struct sharing_comp *sh)
+{
+  if (sh == NULL) return;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    free(sh->diverged[i].keys);
+
+  free(sh->segs);
+  free(sh);
+}
+
+/* ========================================================================== */
+
+static enum share_kind kind_of(struct sharing_comp *sh, size_t slot, uint32_t page)
+{
+  uint32_t bit = 1u << slot;
+
+  for (size_t i = 0; i < sh->n_segs; ++i)
+  {
+    if (page >= sh->segs[i].start && page < sh->segs[i].end && (sh->segs[i].mappers & bit))
+      return SHARE_SEGMENT;
+  }
+
+  if ((sh->forked & bit) && !set_has(&sh->diverged[slot], page))
+    return SHARE_COW;
+
+  return SHARE_NONE;
+}
+
+/* ========================================================================== */
+
+static size_t find_frame(struct virtual_memory *vm, uint32_t page, uint8_t pid, enum share_kind kind)
+{
+  for (size_t i = 0; i < vm->ipt_size; ++i)        // Linear IPT search
+  {
+    struct vmem_entry *e = &vm->ipt[i];
+
+    if (e->set && e->addr == page && e->share == kind && (kind != SHARE_NONE || e->pid == pid))
+      return i;
+  }
+  return (size_t) -1;
+}
+
+/* ========================================================================== */
+
+static int copy_on_write(struct memory *mem, size_t index, uint32_t page, uint8_t pid, uint64_t t, uint32_t ofs)
+{
+  struct virtual_memory *vm = mem->vmem;
+  struct vmem_entry *e = &vm->ipt[index];
+
+  size_t slot = share_slot(vm, pid);
+  bool alone = (e->nmap == 1 && (e->mappers & (1u << slot)));    // Only the writer maps it
+
+  if (!share_diverge(vm->share, slot, page))
+  {
+    mem->error = MEMSIM_ENOMEM;
+    return -1;
+  }
+
+  ipt_unmap(mem, index, pid);
+
+  if (alone)
+  {                         // The shared copy is still clean on the HD, the frame becomes the private one
+    e->share = SHARE_NONE;
+    e->pid   = pid;
+    ipt_touch(mem, index, 'W', t, ofs);
+    return 0;
+  }
+
+  ipt_place(mem, page, pid, 'W', t, ofs);     // The others keep the shared frame
+  if (mem->error) return -1;
+
+  ++mem->cow_faults;
+  return 0;
+}
+
+/* ========================================================================== */
+
+static bool set_has(struct page_set *set, uint32_t page)
+{
+  return (set->size && *set_slot(set, page) != 0);      // Empty sets have no slots yet
+}
+
+/* ========================================================================== */
+
+static uint32_t *set_slot(struct page_set *set, uint32_t page)
+{
+  size_t mask = set->size - 1;
+  size_t i = ((page + 1) * 2654435761u) & mask;
+
+  while (set->keys[i] && set->keys[i] != page + 1)
+    i = (i + 1) & mask;
+
+  return &set->keys[i];
+}
+
+/* ========================================================================== */
+
+static int set_grow(struct page_set *set)
+{
+  struct page_set bigger = { .size = (set->size ? 2 * set->size : SET_SIZE), .count = set->count };
+
+  bigger.keys = calloc(bigger.size, sizeof(uint32_t));
+  if (bigger.keys == NULL) return 0;
+
+  for (size_t i = 0; i < set->size; ++i)
+  {
+    if (set->keys[i])
+      *set_slot(&bigger, set->keys[i] - 1) = set->keys[i];
+  }
+
+  free(set->keys);
+  *set = bigger;
+  return 1;
+}
+
+/* ========================================================================== */
@@ -0,0 +1,41 @@
+/* sharing.h */
+#ifndef SHARING_MODULE
+#define SHARING_MODULE
+
+#include <stdint.h>       // size_t, uint32_t, uint8_t, uint64_t
+
+#include "memory.h"
+
+/* Pages shared between processes. A page of a shared segment takes one    *
+ * frame for every process of the segment. After a fork, every other page  *
+ * takes one frame for the forked processes (copy-on-write) until one of   *
+ * them writes it: the writer then gets a private copy, and diverges from  *
+ * the others on that page for the rest of the run. Only a write to a      *
+ * frame another process maps copies it, a copy-on-write fault; a frame    *
+ * the writer maps alone just turns private.                               */
+
+
+/* Allocates the sharing components, nothing shared yet. Returns NULL if out of memory. */
+struct sharing_comp *share_init(void);
+
+
+/* Returns the slot of process `pid`, as in `vmem->pids`. */
+size_t share_slot(struct virtual_memory *vm, uint8_t pid);
+
+
+/* Records that the process in `slot` has its own copy of `page`. *
+ * Returns 0 if out of memory, else 1.                            */
+int  share_diverge(struct sharing_comp *sh, size_t slot, uint32_t page);
+
+
+/* Requests `page` on behalf of `pid`, finding or placing it in the frame *
+ * shared by the processes it belongs to, as `mem_retrieve()` does.       *
+ * Returns 1 if it page faulted, 0 if not, -1 if out of memory.           */
+int  share_retrieve(struct memory *mem, uint32_t page, uint8_t pid, char mode, uint64_t t, uint32_t ofs);
+
+
+/* Deallocates the sharing components. */
+void share_clean(struct sharing_comp *sh);
+
+
+#endif
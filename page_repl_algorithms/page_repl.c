@@ -1,12 +1,11 @@
 /* page_repl.c */
 // TODO: comments here and to the respective .h
-#include <stdlib.h>         // exit
-#include <stdint.h>         // size_t, int8_t
-#include <stdio.h>
-#include <time.h>           // struct timespec
+#include <stdint.h>         // size_t, int8_t, uint64_t
 
 #include "memory.h"
 #include "page_repl.h"
+#include "ipt_management.h"   // ipt_owns(), ipt_unmap()
+#include "page_table.h"       // pt_unmap()
 #include "queue.h"
 
 
@@ -14,7 +13,8 @@
 static void   rm_entry(struct memory *mem, size_t index);
 
 // Create a set of every distinct page found in the history window.
-static void   make_set(struct queue *set, struct queue **history, size_t index);
+// Returns 0 if out of memory, else 1.
+static int    make_set(struct queue *set, struct queue **history, size_t index);
 
 // Get the WS History Window index associated with the `pid` given.
 static size_t find_history_window(struct virtual_memory *vm, int8_t pid);
@@ -27,20 +27,13 @@ size_t lru(struct memory *mem)
 
   size_t pos = 0;          // Contains the index of the oldest entry
 
-  struct timespec min_t;
-  min_t.tv_sec  = mm->entries[0].latency.tv_sec;
-  min_t.tv_nsec = mm->entries[0].latency.tv_nsec;
+  uint64_t min_t = mm->entries[0].latency;
 
   for (size_t i = 1; i < mm->mm_size; ++i)      // Compare every entry's time
   {                                             // of last reference
-    time_t sec  = mm->entries[i].latency.tv_sec;
-    long   nsec = mm->entries[i].latency.tv_nsec;
-
-    if (sec < min_t.tv_sec || (sec == min_t.tv_sec && nsec < min_t.tv_nsec))
+    if (mm->entries[i].latency < min_t)
     {
-      min_t.tv_sec  = sec;
-      min_t.tv_nsec = nsec;
-
+      min_t = mm->entries[i].latency;
       pos = i;
     }
   }
@@ -51,16 +44,19 @@ size_t lru(struct memory *mem)
 
 /* ========================================================================= */
 
-void ws_update_history_window(struct virtual_memory *vm, uint8_t pid, uint32_t page)
+int ws_update_history_window(struct virtual_memory *vm, uint8_t pid, uint32_t page)
 {
-  struct vmem_entry entry = { 1, pid, page };
+  struct vmem_entry entry = { .set = 1, .pid = pid, .addr = page };
 
   size_t index = find_history_window(vm, pid);
     
   if (queue_is_full(vm->ws->history[index], vm->ws->window_s))
+  {
     queue_emplace_last(vm->ws->history[index], entry);        // Removes first ref, adds current ref as last
-  else
-    queue_insert_last(vm->ws->history[index], entry);         // Add refs until it's full
+    return 1;
+  }
+  
+  return queue_insert_last(vm->ws->history[index], entry);    // Add refs until it's full
 }
 
 /* ========================================================================= */
@@ -71,6 +67,7 @@ static size_t find_history_window(struct virtual_memory *vm, int8_t pid)
     if (vm->ws->history_index[i] == pid)
       return i;
   }
+  return 0;       // Untracked PID, share the 1st window rather than index past the array
 }
 /* ========================================================================= */
 
@@ -80,30 +77,39 @@ size_t working_set(struct memory *mem, uint8_t pid)
 
   vm->ws->set = queue_initialize();       // Create the set
 
-  make_set(vm->ws->set, vm->ws->history, find_history_window(vm, pid));
+  if (vm->ws->set == NULL || !make_set(vm->ws->set, vm->ws->history, find_history_window(vm, pid)))
+  {
+    mem->error = MEMSIM_ENOMEM;       // Still free a frame, the caller stops the run
+    queue_destroy(vm->ws->set);
+    return lru(mem);
+  }
 
   size_t empty = (size_t) -1;         // Index of an empty IPT slot 
   size_t last  = (size_t) -1;         // Greatest IPT index occupied by proccess `pid`
 
   for (size_t i = 0; i < vm->ipt_size; ++i)
   {
-    if (vm->ipt[i].pid != pid) continue;    // Process doesn't own this IPT entry
+    if (!ipt_owns(mem, i, pid)) continue;   // Process doesn't own this IPT entry
 
-    last = i;
-    struct vmem_entry entry = { 1, vm->ipt[i].pid, vm->ipt[i].addr };
+    struct vmem_entry entry = { .set = 1, .pid = pid, .addr = vm->ipt[i].addr };
 
     if (queue_search(vm->ws->set, entry) == 0)       // Ref not in the set
     {
+      if (vm->ipt[i].share != SHARE_NONE && ipt_unmap(mem, i, pid) > 0)
+        continue;               // Others still map it, `pid` no longer does
+
       rm_entry(mem, i);         // Remove it from the IPT
       empty = i;
     }
+    last = i;
   }
 
   // Edge cases
   if (last == (size_t)-1)       // IPT is full with refs from the other process
-  {                             // so the current process has to be suspended/terminated
-    printf("Starvation!"); 
-    exit(EXIT_FAILURE);         // Termination (demonstration purposes)
+  {                             // so the current process starves, the load control
+    ++mem->starvations;         // will suspend someone. Meanwhile take the LRU frame
+    queue_destroy(vm->ws->set);
+    return lru(mem);
   }
   
   if (empty == (size_t)-1)      // Every distinct ref in the History Window is also in the set 
@@ -119,14 +125,56 @@ size_t working_set(struct memory *mem, uint8_t pid)
 
 /* ========================================================================= */
 
-static void make_set(struct queue *set, struct queue **history, size_t index)
+size_t ws_size(struct virtual_memory *vm, uint8_t pid)
+{
+  struct queue *set = queue_initialize();
+
+  if (set == NULL || !make_set(set, vm->ws->history, find_history_window(vm, pid)))
+  {
+    queue_destroy(set);
+    return (size_t) -1;
+  }
+
+  size_t size = set->size;
+  queue_destroy(set);
+
+  return size;
+}
+
+/* ========================================================================= */
+
+size_t evict_process(struct memory *mem, uint8_t pid)
+{
+  struct virtual_memory *vm = mem->vmem;
+
+  size_t freed = 0;
+
+  for (size_t i = 0; i < vm->ipt_size; ++i)
+  {
+    if (vm->ipt[i].set && ipt_owns(mem, i, pid))
+    {
+      if (vm->ipt[i].share != SHARE_NONE && ipt_unmap(mem, i, pid) > 0)
+        continue;               // Others still map it
+
+      rm_entry(mem, i);
+      ++freed;
+    }
+  }
+  return freed;
+}
+
+/* ========================================================================= */
+
+static int make_set(struct queue *set, struct queue **history, size_t index)
 {
   struct queue_node *curr = history[index]->front;   // Get `pid` history window
   while (curr)
   {
-    queue_sorted_insert(set, curr->data);     // Insert in the set
+    if (!queue_sorted_insert(set, curr->data))    // Insert in the set
+      return 0;
     curr = curr->next;
   }
+  return 1;
 }
 
 /* ========================================================================= */
@@ -136,6 +184,16 @@ static void rm_entry(struct memory *mem, size_t index)
   if (mem->mmem->entries[index].modified == 1)     // Write in the HD
     ++mem->hd_writes;
 
+  struct vmem_entry *e = &mem->vmem->ipt[index];
+
+  if (e->nmap > 1)                          // Its mappers lose the frame at once
+    mem->frames_saved -= e->nmap - 1;
+  e->nmap = 0;
+  e->mappers = 0;
+
+  if (mem->vmem->pt)                        // Invalidate its translation
+    pt_unmap(mem->vmem, index);
+
   mem->vmem->ipt[index].set = 0;            // Remove from the IPT 
   mem->mmem->entries[index].set = 0;        // Remove from Main Memory
     
@@ -13,14 +13,25 @@ size_t lru(struct memory *mem);
 
 
 /* Remove pages of process `pid` decided by the Working Set algorithm.  *
- * Return the index of an empty position in the IPT/MainMem.            */
+ * Return the index of an empty position in the IPT/MainMem.            *
+ * If `pid` owns no frames, it starves: the LRU frame is taken instead. */
 size_t working_set(struct memory *mem, uint8_t pid);
 
 
 /* If the window is full, adds the last reference in the window, and removes the oldest one. *
  * Else, inserts the last reference in the history window.                                   *
- * Reference is represented by `pid` and `page`                                              */
-void ws_update_history_window(struct virtual_memory *vm, uint8_t pid, uint32_t page);
+ * Reference is represented by `pid` and `page`                                              *
+ * Returns 0 if out of memory, else 1.                                                       */
+int  ws_update_history_window(struct virtual_memory *vm, uint8_t pid, uint32_t page);
+
+
+/* Return the # of distinct pages in the History Window of `pid`, (size_t) -1 if out of memory. */
+size_t ws_size(struct virtual_memory *vm, uint8_t pid);
+
+
+/* Remove every page of process `pid` from the IPT/MainMem. *
+ * Return the # of frames freed.                            */
+size_t evict_process(struct memory *mem, uint8_t pid);
 
 
 #endif
\ No newline at end of file
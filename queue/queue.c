@@ -1,14 +1,13 @@
 /* queue.c */
-#include <assert.h>
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "queue.h"
 
 struct queue *queue_initialize(void)
 {
-  struct queue *q = malloc(sizeof(struct queue)); //?
-  assert(q);
+  struct queue *q = malloc(sizeof(struct queue));
+  if (q == NULL) return NULL;
+
   q->size = 0;
   q->front = q->tail = NULL;
   return q;
@@ -37,7 +36,7 @@ queue_item_t queue_remove_first(struct queue *q)
 static struct queue_node * create_node(queue_item_t value)
 {
   struct queue_node *new_node = malloc(sizeof(struct queue_node));
-  assert(new_node);
+  if (new_node == NULL) return NULL;
 
   new_node->data = value;
   new_node->next = NULL;
@@ -61,9 +60,11 @@ void queue_emplace_last(struct queue *q, queue_item_t value)
   q->tail = curr;
 }
 
-void queue_insert_last(struct queue *q, queue_item_t value)
+int queue_insert_last(struct queue *q, queue_item_t value)
 {
   struct queue_node *new_node = create_node(value);
+  if (new_node == NULL) return 0;
+
   ++q->size;
 
   if (q->front == NULL){
@@ -74,14 +75,14 @@ void queue_insert_last(struct queue *q, queue_item_t value)
     q->tail->next = new_node;
     q->tail = new_node;    
   }
+  return 1;
 }
 
-void queue_sorted_insert(struct queue *q, queue_item_t value)
+int queue_sorted_insert(struct queue *q, queue_item_t value)
 {
-  ++q->size;
-
   if (q->front == NULL){
-    q->front = q->tail = create_node(value);
+    if ((q->front = q->tail = create_node(value)) == NULL) return 0;
+    ++q->size;
   }
   else
   {
@@ -90,16 +91,16 @@ void queue_sorted_insert(struct queue *q, queue_item_t value)
     while (temp->next)
     {
       if (temp->next->data.addr == value.addr)
-      { 
-        --q->size;     /* If it already exists in the set, do nothing */
-        return; 
-      }
+        return 1;      /* If it already exists in the set, do nothing */
 
       if (temp->next->data.addr > value.addr) break;
       temp = temp->next;
     }
 
     struct queue_node *new_node = create_node(value);
+    if (new_node == NULL) return 0;
+
+    ++q->size;
 
     if (temp->next == NULL)
     {
@@ -112,6 +113,7 @@ void queue_sorted_insert(struct queue *q, queue_item_t value)
       temp->next = new_node;
     }
   }
+  return 1;
 }
 
 // 0 if equal, else 1
@@ -136,6 +138,8 @@ int queue_search(struct queue *q, queue_item_t value)
 
 void queue_destroy(struct queue *q)
 {
+  if (q == NULL) return;
+
   struct queue_node *current = q->front;
   while (current){
     struct queue_node *temp = current->next;
@@ -145,13 +149,3 @@ void queue_destroy(struct queue *q)
   free(q);
 }
 
-
-void queue_print(struct queue *q)
-{
-  struct queue_node *current = q->front;
-
-  while (current){
-    printf("%d\n", current->data.addr);
-    current = current->next;
-  }
-}
\ No newline at end of file
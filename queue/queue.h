@@ -21,7 +21,7 @@ struct queue
   struct queue_node *tail;  
 };
 
-struct queue * queue_initialize(void);
+struct queue * queue_initialize(void);       // NULL if out of memory
 
 int queue_is_empty(struct queue *);
 int queue_is_full (struct queue *, size_t);
@@ -29,14 +29,12 @@ int queue_search  (struct queue *q, queue_item_t value); // 1 if found, else 0
 
 queue_item_t queue_remove_first(struct queue *);
 
-void queue_insert_last  (struct queue *, queue_item_t);
+int  queue_insert_last  (struct queue *, queue_item_t);                 // 0 if out of memory, else 1
 void queue_emplace_last (struct queue *q, queue_item_t value);
-void queue_sorted_insert(struct queue *q, queue_item_t value);
+int  queue_sorted_insert(struct queue *q, queue_item_t value);          // 0 if out of memory, else 1
 
 void queue_destroy(struct queue *);
 
-void queue_print(struct queue *q);
-
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,463 @@
+/* shards.c */
+#include <math.h>         // sqrt, llround
+#include <stdbool.h>      // bool
+#include <stdint.h>       // fixed width types
+#include <stdlib.h>       // malloc, calloc, free, qsort
+
+#include "shards.h"
+#include "memory.h"       // mem_init(), mem_retrieve(), mem_clean()
+
+
+// Hash of a key under a sample's seed (splitmix64 finalizer)
+static uint64_t mix(uint64_t key, uint64_t seed);
+
+// Home slot of a key in a stack's table
+static size_t   home(struct shards_stack *st, uint64_t key);
+
+// Returns 0 if out of memory, else 1
+static int      stack_init (struct shards_stack *st, uint32_t threshold, size_t max_blocks, size_t hist_len);
+static void     stack_clean(struct shards_stack *st);
+
+// Simulates a reference to a sampled page, recording its stack distance
+static void     stack_access(struct shards_stack *st, uint64_t key, uint32_t hash);
+
+// Lowers the threshold until at most `max_blocks` pages are tracked
+static void     stack_shrink(struct shards_stack *st);
+
+// Stops tracking the page `key`
+static void     stack_evict(struct shards_stack *st, uint64_t key);
+
+// Renumbers the last reference times 1..n, once they reach the tree size
+static void     stack_compact(struct shards_stack *st);
+
+static void     tree_add(struct shards_stack *st, uint32_t pos, uint32_t delta);
+static uint32_t tree_sum(struct shards_stack *st, uint32_t pos);
+
+static void     heap_push(struct shards_stack *st, struct shards_block b);
+static struct shards_block heap_pop(struct shards_stack *st);
+
+// Estimated miss ratio of an LRU memory of `frames` frames
+static double   miss_ratio(struct shards_stack *st, size_t frames);
+
+// Mean of the samples' estimates and its 95% confidence interval
+static void     spread(double *v, struct shards_estimate *e);
+
+static int      by_time(const void *a, const void *b);
+
+/* ========================================================================== */
+
+struct shards *shards_init(size_t frames, enum algorithm alg, uint8_t *pids, size_t ws_wnd_s,
+                           double rate, size_t max_blocks)
+{
+  struct shards *sh = calloc(1, sizeof(struct shards));
+  if (sh == NULL) return NULL;
+
+  sh->rate   = rate;
+  sh->frames = frames;
+  sh->alg    = alg;
+
+  uint32_t threshold = llround(rate * SHARDS_MODULUS);
+  if (threshold == 0) threshold = 1;
+
+  size_t s_frames = llround(frames * rate);           // Scale the memory with the sample
+  size_t s_window = llround(ws_wnd_s * rate);
+
+  if (s_frames == 0) s_frames = 1;
+  if (s_window == 0) s_window = 1;
+
+  for (size_t i = 0; i < SHARDS_SAMPLES; ++i)
+  {
+    struct shards_sample *sample = &sh->samples[i];
+
+    sample->seed      = 0x9E3779B97F4A7C15ull * (i + 1);
+    sample->threshold = threshold;
+    sample->mem       = mem_init(s_frames, alg, pids, s_window);
+
+    if (!sample->mem || !stack_init(&sample->stack, threshold, max_blocks ? max_blocks : SHARDS_MAX_BLOCKS,
+                                    SHARDS_MRC_SCALE * frames + 1))
+    {
+      shards_clean(sh);
+      return NULL;
+    }
+  }
+
+  return sh;
+}
+
+/* ========================================================================== */
+
+int shards_run(struct shards *sh, ref_source read_ref, void **srcs, uint8_t *pids,
+               size_t q, size_t max_refs)
+{
+  bool ended[NUM_OF_PROCESSES] = { 0 };
+  size_t n_ended = 0;
+
+  if (q == 0) q = 1;
+
+  while (n_ended < NUM_OF_PROCESSES)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      for (size_t j = 0; j < q && !ended[i]; ++j)
+      {
+        if (max_refs && sh->refs == max_refs) return MEMSIM_OK;
+
+        uint32_t addr;
+        char mode;
+
+        int status = read_ref(srcs[i], &addr, &mode);
+
+        if (status == REF_AGAIN) break;       // Another process has to read first
+        if (status == REF_ERROR) return MEMSIM_EIO;
+        if (status == REF_END)
+        {
+          ended[i] = 1;
+          ++n_ended;
+          break;
+        }
+
+        ++sh->refs;
+
+        uint32_t page = addr >> OFFSET_BITS;
+        uint64_t key  = ((uint64_t) (pids[i] + 1) << 32) | page;   // Never 0
+
+        for (size_t k = 0; k < SHARDS_SAMPLES; ++k)
+        {
+          struct shards_sample *sample = &sh->samples[k];
+          uint32_t hash = mix(key, sample->seed) & (SHARDS_MODULUS - 1);
+
+          if (hash >= sample->threshold) continue;
+
+          if (mem_retrieve(sample->mem, addr, mode, pids[i]) == -1)
+            return MEMSIM_ENOMEM;
+          sh->sampled += (k == 0);
+
+          if (hash < sample->stack.threshold)
+            stack_access(&sample->stack, key, hash);
+        }
+      }
+    }
+  }
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+void shards_results(struct shards *sh, struct shards_results *r)
+{
+  double faults[SHARDS_SAMPLES], writes[SHARDS_SAMPLES], mr[SHARDS_SAMPLES];
+  double refs = sh->refs;
+
+  r->refs     = sh->refs;
+  r->sampled  = sh->sampled;
+  r->rate     = (double) sh->samples[0].threshold / SHARDS_MODULUS;
+  r->mrc_rate = 1.0;
+  r->max_tracked = 0;
+
+  for (size_t i = 0; i < SHARDS_SAMPLES; ++i)
+  {
+    struct shards_sample *sample = &sh->samples[i];
+
+    size_t n = sample->mem->total_req;      // Rates in the sample, applied to every reference
+    faults[i] = n ? refs * sample->mem->page_fs   / n : 0.0;
+    writes[i] = n ? refs * sample->mem->hd_writes / n : 0.0;
+
+    if (sh->alg == LRU)                     // At the adapted rate
+      faults[i] = refs * miss_ratio(&sample->stack, sh->frames);
+
+    double rate = (double) sample->stack.threshold / SHARDS_MODULUS;
+    if (rate < r->mrc_rate) r->mrc_rate = rate;
+
+    if (sample->stack.n_blocks > r->max_tracked)
+      r->max_tracked = sample->stack.n_blocks;
+  }
+
+  spread(faults, &r->page_fs);
+  spread(writes, &r->hd_writes);
+
+  for (size_t k = 0; k < SHARDS_MRC_POINTS; ++k)
+  {
+    size_t frames = (sh->frames << k) / SHARDS_MRC_SCALE;     // frames/8 .. frames*8
+
+    r->mrc[k] = (struct shards_estimate) { 0.0, 0.0 };
+    r->mrc_frames[k] = 0;                   // Distances are counted in steps of 1/R
+    if (frames * r->mrc_rate < SHARDS_MIN_SCALED) continue;
+
+    r->mrc_frames[k] = frames;
+
+    for (size_t i = 0; i < SHARDS_SAMPLES; ++i)
+      mr[i] = miss_ratio(&sh->samples[i].stack, frames);
+
+    spread(mr, &r->mrc[k]);
+  }
+}
+
+/* ========================================================================== */
+
+void shards_clean(struct shards *sh)
+{
+  for (size_t i = 0; i < SHARDS_SAMPLES; ++i)
+  {
+    mem_clean(sh->samples[i].mem);          // Both may be partly initialized
+    stack_clean(&sh->samples[i].stack);
+  }
+  free(sh);
+}
+
+/* ========================================================================== */
+
+static uint64_t mix(uint64_t key, uint64_t seed)
+{
+  uint64_t z = key + seed;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+/* ========================================================================== */
+
+static size_t home(struct shards_stack *st, uint64_t key)
+{
+  return (size_t) ((key * 0x9E3779B97F4A7C15ull) >> 32) & st->table_mask;
+}
+
+/* ========================================================================== */
+
+static int stack_init(struct shards_stack *st, uint32_t threshold, size_t max_blocks, size_t hist_len)
+{
+  st->threshold  = threshold;
+  st->max_blocks = max_blocks;
+
+  size_t slots = 1;
+  while (slots < 2 * (max_blocks + 1))    // At most half full
+    slots <<= 1;
+
+  st->table = calloc(slots, sizeof(struct shards_block));
+  st->table_mask = slots - 1;
+  st->n_blocks   = 0;
+
+  st->heap  = malloc((max_blocks + 1) * sizeof(struct shards_block));
+  st->order = malloc((max_blocks + 1) * sizeof(struct shards_block *));
+
+  st->tree_size = 2 * (max_blocks + 1);
+  st->tree = calloc(st->tree_size + 1, sizeof(uint32_t));     // 1-based
+  st->now = 0;
+
+  st->hist = calloc(hist_len, sizeof(double));
+  st->hist_len = hist_len;
+  st->far = st->cold = st->total = 0.0;
+
+  return (st->table && st->heap && st->order && st->tree && st->hist);
+}
+
+/* ========================================================================== */
+
+static void stack_clean(struct shards_stack *st)
+{
+  free(st->table);
+  free(st->heap);
+  free(st->order);
+  free(st->tree);
+  free(st->hist);
+}
+
+/* ========================================================================== */
+
+static void stack_access(struct shards_stack *st, uint64_t key, uint32_t hash)
+{
+  double weight = (double) SHARDS_MODULUS / st->threshold;   // References it stands for
+
+  st->total += weight;
+
+  size_t i = home(st, key);
+  while (st->table[i].key && st->table[i].key != key)
+    i = (i + 1) & st->table_mask;
+
+  if (st->now == st->tree_size)
+    stack_compact(st);
+
+  if (st->table[i].key)
+  {                       // # Distinct pages referenced since, each one stands for `weight`
+    uint32_t dist = tree_sum(st, st->now) - tree_sum(st, st->table[i].time);
+    size_t scaled = llround(dist * weight);     // Not truncated: the threshold is rounded,
+                                                // `weight` is a hair under 1/R
+
+    if (scaled < st->hist_len)
+      st->hist[scaled] += weight;
+    else
+      st->far += weight;
+
+    tree_add(st, st->table[i].time, -1);
+    st->table[i].time = ++st->now;
+    tree_add(st, st->now, 1);
+    return;
+  }
+
+  st->cold += weight;
+
+  st->table[i] = (struct shards_block) { .key = key, .hash = hash, .time = ++st->now };
+  tree_add(st, st->now, 1);
+  heap_push(st, st->table[i]);
+
+  if (++st->n_blocks > st->max_blocks)
+    stack_shrink(st);
+}
+
+/* ========================================================================== */
+
+static void stack_shrink(struct shards_stack *st)
+{
+  st->threshold = st->heap[0].hash;     // Pages hashed from here on aren't sampled
+
+  while (st->n_blocks && st->heap[0].hash >= st->threshold)
+    stack_evict(st, heap_pop(st).key);
+}
+
+/* ========================================================================== */
+
+static void stack_evict(struct shards_stack *st, uint64_t key)
+{
+  size_t i = home(st, key);
+  while (st->table[i].key != key)
+    i = (i + 1) & st->table_mask;
+
+  tree_add(st, st->table[i].time, -1);
+  --st->n_blocks;
+                                        // Shift back the pages probed past it
+  for (size_t j = (i + 1) & st->table_mask; st->table[j].key; j = (j + 1) & st->table_mask)
+  {
+    size_t h = home(st, st->table[j].key);
+
+    if (((j - h) & st->table_mask) >= ((j - i) & st->table_mask))
+    {
+      st->table[i] = st->table[j];
+      i = j;
+    }
+  }
+  st->table[i].key = 0;
+}
+
+/* ========================================================================== */
+
+static void stack_compact(struct shards_stack *st)
+{
+  struct shards_block **order = st->order;
+
+  size_t n = 0;
+  for (size_t i = 0; i <= st->table_mask; ++i)
+  {
+    if (st->table[i].key)
+      order[n++] = &st->table[i];
+  }
+
+  qsort(order, n, sizeof(struct shards_block *), by_time);
+
+  for (uint32_t i = 0; i <= st->tree_size; ++i)
+    st->tree[i] = 0;
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    order[i]->time = i + 1;
+    tree_add(st, i + 1, 1);
+  }
+  st->now = n;
+}
+
+/* ========================================================================== */
+
+static void tree_add(struct shards_stack *st, uint32_t pos, uint32_t delta)
+{
+  for (; pos <= st->tree_size; pos += pos & -pos)
+    st->tree[pos] += delta;
+}
+
+/* ========================================================================== */
+
+static uint32_t tree_sum(struct shards_stack *st, uint32_t pos)
+{
+  uint32_t sum = 0;
+  for (; pos > 0; pos -= pos & -pos)
+    sum += st->tree[pos];
+  return sum;
+}
+
+/* ========================================================================== */
+
+static void heap_push(struct shards_stack *st, struct shards_block b)
+{
+  size_t i = st->n_blocks;
+
+  while (i > 0 && st->heap[(i - 1) / 2].hash < b.hash)
+  {
+    st->heap[i] = st->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  st->heap[i] = b;
+}
+
+/* ========================================================================== */
+
+static struct shards_block heap_pop(struct shards_stack *st)
+{
+  struct shards_block top  = st->heap[0];
+  struct shards_block last = st->heap[st->n_blocks - 1];    // n_blocks still counts `top`
+  size_t n = st->n_blocks - 1;
+  size_t i = 0;
+
+  while (2 * i + 1 < n)
+  {
+    size_t child = 2 * i + 1;
+    if (child + 1 < n && st->heap[child + 1].hash > st->heap[child].hash)
+      ++child;
+
+    if (st->heap[child].hash <= last.hash) break;
+
+    st->heap[i] = st->heap[child];
+    i = child;
+  }
+  st->heap[i] = last;
+
+  return top;
+}
+
+/* ========================================================================== */
+
+static double miss_ratio(struct shards_stack *st, size_t frames)
+{
+  if (st->total == 0) return 0.0;
+
+  double misses = st->cold + st->far;     // Hit only if fewer than `frames` pages came between
+
+  for (size_t d = frames; d < st->hist_len; ++d)
+    misses += st->hist[d];
+
+  return misses / st->total;
+}
+
+/* ========================================================================== */
+
+static void spread(double *v, struct shards_estimate *e)
+{
+  double sum = 0.0, sq = 0.0;
+
+  for (size_t i = 0; i < SHARDS_SAMPLES; ++i)
+    sum += v[i];
+  e->mean = sum / SHARDS_SAMPLES;
+
+  for (size_t i = 0; i < SHARDS_SAMPLES; ++i)
+    sq += (v[i] - e->mean) * (v[i] - e->mean);
+                                        // Standard error of the mean, by Student's t
+  e->ci = SHARDS_T95 * sqrt(sq / (SHARDS_SAMPLES - 1)) / sqrt(SHARDS_SAMPLES);
+}
+
+/* ========================================================================== */
+
+static int by_time(const void *a, const void *b)
+{
+  uint32_t ta = (*(struct shards_block * const *) a)->time;
+  uint32_t tb = (*(struct shards_block * const *) b)->time;
+
+  return (ta > tb) - (ta < tb);
+}
+
+/* ========================================================================== */
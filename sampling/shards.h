@@ -0,0 +1,137 @@
+/* shards.h */
+#ifndef SHARDS_MODULE
+#define SHARDS_MODULE
+
+#include <stdint.h>     // uint8_t, uint32_t, uint64_t, size_t
+
+#include "memory.h"     // struct memory, enum algorithm, NUM_OF_PROCESSES
+#include "scheduler.h"  // ref_source
+
+#define SHARDS_MODULUS    (1u << 24)  // Pages hash in [0, modulus), sampled if under a threshold
+#define SHARDS_SAMPLES    8           // Independent samples (hash seeds), for the error bars
+#define SHARDS_T95        2.365       // Student's t of a 95% interval, SHARDS_SAMPLES - 1 d.o.f.
+#define SHARDS_MAX_BLOCKS 8192        // Default # pages tracked per sample for the MRC
+#define SHARDS_MRC_SCALE  8           // The MRC goes up to this many times the frames
+#define SHARDS_MRC_POINTS 7           // frames/8, frames/4, ..., frames*8
+#define SHARDS_MIN_SCALED 10          // Fewer frames times the rate are too coarse for the MRC
+
+/* Spatially hashed sampling (SHARDS): a page (PID, page address) is kept      *
+ * if its hash is under a threshold T, i.e. with rate R = T / modulus.        *
+ * Every reference to a kept page is simulated, so a sample behaves like the  *
+ * full trace on a memory R times smaller: estimates are scaled back by 1/R. *
+ * LRU faults come from the stack distance pass, whose rate adapts to bound  *
+ * its memory; WS has no stack property, so its faults come from a memory    *
+ * scaled by the initial rate, as do the writes of both.                     *
+ * The error of an estimate shrinks with the pages a sample keeps: a few     *
+ * percent with hundreds, about 1% with thousands.                           */
+
+// Page tracked by the stack distance pass
+struct shards_block
+{
+  uint64_t key;               // PID and page address, 0 if the slot is free
+  uint32_t hash;
+  uint32_t time;              // Logical time of its last reference
+};
+
+
+// LRU stack distances of the pages sampled, in bounded memory:
+// when too many pages are tracked, the threshold drops (adaptive rate)
+struct shards_stack
+{
+  uint32_t threshold;
+  size_t max_blocks;
+
+  struct shards_block *table;     // Tracked pages, open addressing
+  size_t table_mask;
+  size_t n_blocks;
+
+  struct shards_block *heap;      // Tracked pages, max heap on the hash
+  struct shards_block **order;    // Tracked pages sorted by time, when compacting
+
+  uint32_t *tree;                 // Fenwick tree, marks the last time of every page
+  uint32_t tree_size;
+  uint32_t now;
+
+  double *hist;                   // Est. # references per stack distance (pages)
+  size_t hist_len;                // Farther distances are counted as `far`
+  double far;
+  double cold;                    // Est. # references to pages never seen before
+  double total;
+};
+
+
+// One sample: a memory R0 times smaller, and an LRU stack distance pass
+struct shards_sample
+{
+  uint64_t seed;
+  uint32_t threshold;             // Sampling threshold of the scaled memory, fixed
+  struct memory *mem;
+  struct shards_stack stack;
+};
+
+
+// Estimate from the samples
+struct shards_estimate
+{
+  double mean;                    // Mean of the samples' estimates
+  double ci;                      // Half width of its 95% confidence interval
+};
+
+
+struct shards_results
+{
+  size_t refs;                    // # References read
+  size_t sampled;                 // # References kept by the 1st sample
+  double rate;                    // Initial sampling rate
+  double mrc_rate;                // Lowest rate the MRC pass adapted to
+  size_t max_tracked;             // Most pages tracked by a sample's MRC pass
+
+  struct shards_estimate page_fs;
+  struct shards_estimate hd_writes;
+
+  size_t mrc_frames[SHARDS_MRC_POINTS];               // 0 if too few frames to scale down
+  struct shards_estimate mrc[SHARDS_MRC_POINTS];      // LRU miss ratio
+};
+
+
+struct shards
+{
+  double rate;                    // Initial sampling rate (R0)
+  size_t frames;
+  enum algorithm alg;
+
+  struct shards_sample samples[SHARDS_SAMPLES];
+
+  size_t refs;                    // # References read
+  size_t sampled;                 // # References kept by the 1st sample
+};
+
+
+/* Initializes a sampled simulation of `frames` frames at rate `rate`.  *
+ * Every sample runs `alg` on round(frames * rate) frames, with the     *
+ * Working Set window scaled the same way. At most `max_blocks` pages   *
+ * are tracked per sample for the MRC, 0 for SHARDS_MAX_BLOCKS.        *
+ * Returns NULL if out of memory.                                       */
+struct shards *shards_init(size_t frames, enum algorithm alg, uint8_t *pids, size_t ws_wnd_s,
+                           double rate, size_t max_blocks);
+
+
+/* Reads the processes' references q at a time, round-robin (as the default  *
+ * scheduler does without disk latency), until they end or `max_refs` are    *
+ * read (0 for no limit), and simulates the sampled ones.                    *
+ * Returns MEMSIM_OK, MEMSIM_ENOMEM if it stopped out of memory, or          *
+ * MEMSIM_EIO if a trace couldn't be read.                                    */
+int  shards_run(struct shards *sh, ref_source read_ref, void **srcs, uint8_t *pids,
+                size_t q, size_t max_refs);
+
+
+/* Gets the estimated stats with their 95% confidence intervals, *
+ * and the estimated LRU miss ratio curve.                        */
+void shards_results(struct shards *sh, struct shards_results *r);
+
+
+/* Deallocates a sampled simulation. */
+void shards_clean(struct shards *sh);
+
+
+#endif
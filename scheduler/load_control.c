@@ -0,0 +1,184 @@
+/* load_control.c */
+#include <stdint.h>       // size_t, uint8_t
+#include <stdlib.h>       // realloc
+
+#include "load_control.h"
+#include "memory.h"       // mem_release(), mem_ws_size(), mem_resident()
+#include "scheduler.h"
+
+
+// Swap out process `index`, releasing its frames.
+static void suspend(struct scheduler *s, struct memory *mem, int index);
+
+// Bring process `index` back to the ready queue.
+static void resume(struct scheduler *s, int index);
+
+// # Ticks since suspended process `index` was swapped out.
+static size_t suspended_for(struct scheduler *s, int index);
+
+// # Frames process `pid` needs: its working set (WS), or the frames it holds (LRU).
+static size_t need(struct memory *mem, uint8_t pid);
+
+/* ========================================================================== */
+
+void lc_check(struct scheduler *s, struct memory *mem)
+{
+  double pf_rate = s->lc_refs ? (double) s->lc_faults / s->lc_refs : 0.0;
+  int starved = (mem->starvations != s->lc_starv);
+
+  s->lc_refs = s->lc_faults = 0;        // Start a new window
+  s->lc_starv = mem->starvations;
+
+  size_t active = 0;          // # Processes competing for frames
+  size_t waiting = 0;         // # Of them waiting for input
+  size_t need_sum = 0;        // Sum of the frames they need
+  int victim = -1;            // Lowest priority active process holding frames
+  int back   = -1;            // Highest priority suspended process
+
+  for (int i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    struct process *p = &s->procs[i];
+
+    if (p->state == PROC_DONE) continue;
+
+    if (p->state == PROC_SUSPENDED)
+    {
+      if (back == -1 || p->prio > s->procs[back].prio)
+        back = i;
+      continue;
+    }
+
+    ++active;
+    waiting += (p->state == PROC_INPUT);
+    need_sum += need(mem, p->pid);
+
+    if (mem_resident(mem, p->pid) == 0)
+      continue;               // Suspending it would free nothing
+
+    if (victim == -1 || p->prio <= s->procs[victim].prio)
+      victim = i;
+  }
+
+  size_t frames = mem->vmem->ipt_size;
+
+  int thrashing = (need_sum > frames || pf_rate > s->cfg.lc_max_pf || starved);
+
+  if (back != -1 && active == waiting)     // Nobody else can use the memory
+  {
+    resume(s, back);
+    return;
+  }
+
+  size_t held = (back != -1 ? suspended_for(s, back) : 0);
+
+  if (back != -1 && held >= LC_MAX_SUSPENSION * s->cfg.lc_window)
+  {                           // Suspended long enough, even if it still doesn't fit
+    resume(s, back);
+    return;
+  }
+
+  if (thrashing && active > 1 && victim != -1)
+  {
+    suspend(s, mem, victim);
+    return;
+  }
+                              // A resume right away would only undo the suspension
+  if (back == -1 || held < LC_MIN_SUSPENSION * s->cfg.lc_window) return;
+
+  int fits = (need_sum + s->procs[back].need <= frames);
+
+  if (active == 1 && fits)    // The fault rate of a process alone says nothing of
+  {                           // contention, it mustn't keep the others out for good
+    resume(s, back);
+    return;
+  }
+                              // Resume only if it fits and the rate dropped enough
+  if (!thrashing && fits && pf_rate <= s->cfg.lc_max_pf / 2)
+    resume(s, back);
+}
+
+/* ========================================================================== */
+
+void lc_finish(struct scheduler *s)
+{
+  for (int i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (s->procs[i].state == PROC_SUSPENDED)
+      resume(s, i);
+  }
+}
+
+/* ========================================================================== */
+
+static void suspend(struct scheduler *s, struct memory *mem, int index)
+{
+  struct process *p = &s->procs[index];
+
+  if (s->n_susp == s->susp_cap)
+  {
+    size_t cap = (s->susp_cap ? 2 * s->susp_cap : 16);
+    struct suspension *susp = realloc(s->susp, cap * sizeof(struct suspension));
+
+    if (susp == NULL)
+    {
+      s->error = MEMSIM_ENOMEM;     // Can't log it, so don't suspend it
+      return;
+    }
+    s->susp = susp;
+    s->susp_cap = cap;
+  }
+
+  if (s->curr == index)
+    s->curr = -1;             // Take away the CPU
+
+  p->need  = need(mem, p->pid);
+  p->state = PROC_SUSPENDED;
+
+  s->susp[s->n_susp++] = (struct suspension)
+  {
+    .pid = p->pid, .start = s->clock, .end = 0, .freed = mem_release(mem, p->pid)
+  };
+}
+
+/* ========================================================================== */
+
+static void resume(struct scheduler *s, int index)
+{
+  struct process *p = &s->procs[index];
+
+  for (size_t i = s->n_susp; i-- > 0; )     // Close its latest interval
+  {
+    if (s->susp[i].pid == p->pid)
+    {
+      s->susp[i].end = s->clock;
+      p->susp_t += s->clock - s->susp[i].start;
+      break;
+    }
+  }
+
+  p->state = PROC_READY;      // Pages are read back on demand
+}
+
+/* ========================================================================== */
+
+static size_t suspended_for(struct scheduler *s, int index)
+{
+  for (size_t i = s->n_susp; i-- > 0; )     // Its latest interval is the open one
+  {
+    if (s->susp[i].pid == s->procs[index].pid)
+      return s->clock - s->susp[i].start;
+  }
+  return 0;
+}
+
+/* ========================================================================== */
+
+static size_t need(struct memory *mem, uint8_t pid)
+{
+  if (mem->vmem->pg_repl == WS)
+    return mem_ws_size(mem, pid);
+
+  return mem_resident(mem, pid);
+}
+
+/* ========================================================================== */
\ No newline at end of file
@@ -0,0 +1,29 @@
+/* load_control.h */
+#ifndef LOAD_CONTROL
+#define LOAD_CONTROL
+
+#include "memory.h"
+#include "scheduler.h"
+
+#define LC_MIN_SUSPENSION 2     // A suspension lasts at least this many `lc_window`s, in ticks,
+#define LC_MAX_SUSPENSION 10    //   and at most this many
+
+/* Medium-term scheduler, run every `lc_window` references or on starvation.   *
+ * A process needs the frames of its working set (WS), or the frames it holds  *
+ * (LRU, which fills every frame it's given).                                  *
+ * Thrashing is detected when the needs don't fit in the frames, or the fault  *
+ * rate of the last window exceeds `lc_max_pf`. While thrashing, the lowest    *
+ * priority process holding frames is suspended and its frames are released   *
+ * in bulk. Once memory frees up, suspended processes resume: when its need    *
+ * fits next to the others', and their fault rate dropped (unless one process  *
+ * runs alone, whose fault rate is no contention). A suspension lasts from     *
+ * LC_MIN_SUSPENSION to LC_MAX_SUSPENSION windows, unless nobody else can use  *
+ * the memory: neither churn nor starvation.                                   */
+void lc_check(struct scheduler *s, struct memory *mem);
+
+
+/* Ends every open suspension interval at the current tick. */
+void lc_finish(struct scheduler *s);
+
+
+#endif
@@ -0,0 +1,400 @@
+/* scheduler.c */
+#include <stdbool.h>      // bool
+#include <stdint.h>       // size_t, uint32_t, uint8_t
+#include <stdlib.h>       // malloc, free
+
+#include "load_control.h" // lc_check(), lc_finish()
+#include "memory.h"       // mem_retrieve(), NUM_OF_PROCESSES
+#include "scheduler.h"
+
+
+// Wake up every blocked process whose disk request has completed.
+static void wake_up(struct scheduler *s);
+
+// Choose the ready process that should run next, -1 if none is ready.
+static int  pick_next(struct scheduler *s);
+
+// Check whether the running process has to give up the CPU.
+static int  must_preempt(struct scheduler *s);
+
+// Give the CPU to process `index`, paying for a context switch if needed.
+static void dispatch(struct scheduler *s, int index);
+
+// Advance the clock up to the earliest disk completion.
+static void idle(struct scheduler *s);
+
+// Refill the staged references of `p` from its source, if it has none left.
+// Returns REF_OK if references are staged, else why none could be read.
+static int  stage(struct scheduler *s, struct process *p);
+
+// # References the running process may execute before the scheduler must step in.
+static size_t budget(struct scheduler *s);
+
+/* ========================================================================== */
+
+struct scheduler *sched_init(struct sched_config *cfg, uint8_t *pids, int *prios, ref_source next_ref, void **srcs)
+{
+  struct scheduler *s = calloc(1, sizeof(struct scheduler));
+  if (s == NULL) return NULL;
+
+  s->cfg = *cfg;
+  s->next_ref = next_ref;
+  s->curr = s->last = -1;
+
+  if (s->cfg.lc_window == 0)
+    s->cfg.lc_window = 1000;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    s->procs[i].pid   = pids[i];
+    s->procs[i].prio  = (prios ? prios[i] : 0);
+    s->procs[i].src   = srcs[i];
+    s->procs[i].state = PROC_READY;
+
+    for (size_t j = 0; j < SCHED_BATCH; ++j)
+      s->procs[i].st_pids[j] = pids[i];
+  }
+
+  return s;
+}
+
+/* ========================================================================== */
+
+int sched_run(struct scheduler *s, struct memory *mem)
+{
+  size_t every = s->cfg.ckpt_every;
+
+  if (every)
+    s->next_ckpt = (s->refs / every + 1) * every;
+
+  while (s->refs < s->cfg.max_refs || s->cfg.max_refs == 0)
+  {
+    if (mem->error || s->error) break;     // Out of memory or input, the state is incomplete
+
+    if (every && s->refs >= s->next_ckpt)
+    {                             // Consistent state, between two iterations
+      s->cfg.ckpt(s, mem, s->cfg.ckpt_arg);
+      s->next_ckpt = (s->refs / every + 1) * every;
+    }
+
+    wake_up(s);
+
+    if (s->curr != -1 && must_preempt(s))
+    {
+      s->procs[s->curr].state = PROC_READY;    // Back to the ready queue
+      s->curr = -1;
+    }
+
+    if (s->curr == -1)
+    {
+      int next = pick_next(s);
+
+      if (next == -1)
+      {
+        size_t blocked = 0, suspended = 0;
+        for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+        {
+          blocked   += (s->procs[i].state == PROC_BLOCKED);
+          suspended += (s->procs[i].state == PROC_SUSPENDED);
+        }
+
+        if (blocked == 0 && suspended == 0) break;      // Every trace has ended
+
+        if (blocked == 0)
+          lc_check(s, mem);       // Only suspended processes can make progress
+        else
+          idle(s);
+        continue;
+      }
+
+      dispatch(s, next);
+    }
+
+    struct process *p = &s->procs[s->curr];
+
+    int status = stage(s, p);
+
+    if (status == REF_ERROR)
+    {
+      s->error = MEMSIM_EIO;      // The run can't go on without the rest of the trace
+      continue;
+    }
+
+    if (status == REF_END)
+    {
+      p->state  = PROC_DONE;      // Trace ended, the process exits
+      p->finish = s->clock;
+      s->curr   = -1;
+      continue;
+    }
+
+    if (status == REF_AGAIN)
+    {
+      p->state = PROC_INPUT;      // Wait until someone else consumes input
+      p->wake  = s->refs;
+      s->curr  = -1;
+      continue;
+    }
+
+    size_t n = budget(s);
+    if (n > p->st_count - p->st_head)
+      n = p->st_count - p->st_head;
+
+    size_t faults = mem->page_fs;
+    bool   stop   = (s->cfg.disk_lat > 0 || s->cfg.policy == FAULT_SWITCH || s->cfg.lc_max_pf > 0);
+
+    n = mem_retrieve_batch(mem, &p->st_addrs[p->st_head], &p->st_modes[p->st_head],
+                           p->st_pids, n, stop);        // Run until a fault, if it matters
+
+    faults = mem->page_fs - faults;
+    p->st_head += n;
+
+    if (p->st_head == p->st_count)
+    {                             // Read ahead, so an ended process isn't dispatched just to find out
+      status = stage(s, p);
+
+      if (status == REF_ERROR)
+      {
+        s->error = MEMSIM_EIO;
+        continue;
+      }
+      p->ended = (status == REF_END);
+    }
+
+    s->clock += n;
+    s->busy  += n;
+    s->refs  += n;
+    s->slice += n;
+    p->refs  += n;
+    p->faults += faults;
+
+    if (s->cfg.report && s->cfg.report_every && s->refs % s->cfg.report_every == 0)
+      s->cfg.report(s, mem, s->cfg.report_arg);
+
+    bool blocks = (faults && stop && s->cfg.disk_lat > 0);
+
+    if (p->ended && !blocks)
+    {
+      p->state  = PROC_DONE;      // Trace ended, the process exits
+      p->finish = s->clock;
+      s->curr   = -1;
+      continue;
+    }
+
+    if (s->cfg.lc_max_pf > 0)     // Medium-term scheduling
+    {
+      s->lc_refs   += n;
+      s->lc_faults += faults;
+
+      if (s->lc_refs >= s->cfg.lc_window || mem->starvations != s->lc_starv)
+      {
+        lc_check(s, mem);
+        if (p->state == PROC_SUSPENDED) continue;
+      }
+    }
+
+    if (!faults || !stop) continue;       // A fault, if any, was the last reference
+
+    if (blocks)
+    {                                           // Wait for the page to be read
+      p->state = PROC_BLOCKED;
+      p->wake  = s->clock + s->cfg.disk_lat;
+      p->blocked_t += s->cfg.disk_lat;
+      s->curr = -1;
+    }
+    else if (s->cfg.policy == FAULT_SWITCH)     // Yield the CPU anyway
+    {
+      p->state = PROC_READY;
+      s->curr  = -1;
+    }
+  }
+
+  if (mem->error || s->error)
+    return (mem->error ? mem->error : s->error);
+
+  if (s->cfg.ckpt)                // Last checkpoint, the run may be continued from here
+    s->cfg.ckpt(s, mem, s->cfg.ckpt_arg);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)    // Outstanding disk requests still complete
+  {
+    if (s->procs[i].state == PROC_BLOCKED && s->procs[i].wake > s->clock)
+      s->clock = s->procs[i].wake;
+  }
+
+  lc_finish(s);
+
+  return MEMSIM_OK;
+}
+
+/* ========================================================================== */
+
+static void wake_up(struct scheduler *s)
+{
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (s->procs[i].state == PROC_BLOCKED && s->procs[i].wake <= s->clock)
+    {
+      if (s->procs[i].ended)
+      {
+        s->procs[i].state  = PROC_DONE;     // Its last reference was that fault
+        s->procs[i].finish = s->procs[i].wake;
+      }
+      else
+        s->procs[i].state = PROC_READY;
+    }
+
+    if (s->procs[i].state == PROC_INPUT && s->procs[i].wake < s->refs)
+      s->procs[i].state = PROC_READY;
+  }
+}
+
+/* ========================================================================== */
+
+static int pick_next(struct scheduler *s)
+{
+  int best = -1;
+
+  for (int k = 1; k <= NUM_OF_PROCESSES; ++k)     // Start after the last process that ran
+  {
+    int i = (s->last + k + NUM_OF_PROCESSES) % NUM_OF_PROCESSES;
+
+    if (s->procs[i].state != PROC_READY) continue;
+
+    if (s->cfg.policy != PRIORITY)
+      return i;
+
+    if (best == -1 || s->procs[i].prio > s->procs[best].prio)
+      best = i;
+  }
+  return best;
+}
+
+/* ========================================================================== */
+
+static int must_preempt(struct scheduler *s)
+{
+  struct process *p = &s->procs[s->curr];
+
+  if (s->cfg.policy == PRIORITY)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)     // A more important process woke up
+    {
+      if (s->procs[i].state == PROC_READY && s->procs[i].prio > p->prio)
+        return 1;
+    }
+  }
+
+  if (s->cfg.policy == FAULT_SWITCH)
+    return 0;
+
+  return (s->slice >= s->cfg.quantum);    // Time slice expired
+}
+
+/* ========================================================================== */
+
+static void dispatch(struct scheduler *s, int index)
+{
+  if (s->last != -1 && s->last != index)
+  {
+    ++s->ctx_switches;
+    s->clock    += s->cfg.cs_cost;
+    s->switch_t += s->cfg.cs_cost;
+  }
+
+  struct process *p = &s->procs[index];
+
+  ++p->dispatches;
+  p->state = PROC_RUNNING;
+  s->curr  = s->last = index;
+  s->slice = 0;
+}
+
+/* ========================================================================== */
+
+static void idle(struct scheduler *s)
+{
+  size_t wake = (size_t) -1;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (s->procs[i].state == PROC_BLOCKED && s->procs[i].wake < wake)
+      wake = s->procs[i].wake;
+  }
+
+  s->clock = wake;      // Nothing to run until the disk responds
+}
+
+/* ========================================================================== */
+
+static int stage(struct scheduler *s, struct process *p)
+{
+  if (p->st_head < p->st_count)
+    return REF_OK;
+
+  if (p->ended)
+    return REF_END;
+
+  int status = REF_OK;
+  p->st_head = p->st_count = 0;
+
+  while (p->st_count < SCHED_BATCH)
+  {
+    status = s->next_ref(p->src, &p->st_addrs[p->st_count], &p->st_modes[p->st_count]);
+    if (status != REF_OK) break;
+
+    ++p->st_count;
+  }
+
+  return (p->st_count ? REF_OK : status);
+}
+
+/* ========================================================================== */
+
+static size_t budget(struct scheduler *s)
+{
+  struct process *p = &s->procs[s->curr];
+  size_t n = SCHED_BATCH;
+
+  #define LIMIT(x) do { if ((x) < n) n = (x); } while (0)
+
+  if (s->cfg.policy != FAULT_SWITCH)
+    LIMIT(s->cfg.quantum - s->slice);                 // End of the time slice
+
+  if (s->cfg.max_refs)
+    LIMIT(s->cfg.max_refs - s->refs);
+
+  if (s->cfg.lc_max_pf > 0)
+    LIMIT(s->cfg.lc_window - s->lc_refs);             // Next load control check
+
+  if (s->cfg.report_every)
+    LIMIT(s->cfg.report_every - s->refs % s->cfg.report_every);
+
+  if (s->cfg.ckpt_every)
+    LIMIT(s->next_ckpt - s->refs);
+
+  if (s->cfg.policy == PRIORITY)
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)     // A more important process wakes up
+    {
+      struct process *o = &s->procs[i];
+      if (o->prio <= p->prio) continue;
+
+      if (o->state == PROC_BLOCKED) LIMIT(o->wake - s->clock);
+      if (o->state == PROC_INPUT)   LIMIT(1);
+    }
+  }
+
+  #undef LIMIT
+
+  return n;
+}
+
+/* ========================================================================== */
+
+void sched_clean(struct scheduler *s)
+{
+  free(s->susp);
+  free(s);
+}
+
+/* ========================================================================== */
@@ -0,0 +1,146 @@
+/* scheduler.h */
+#ifndef SCHEDULER_MODULE
+#define SCHEDULER_MODULE
+
+#include <stdbool.h>    // bool
+#include <stdint.h>     // uint8_t, uint32_t, size_t
+
+#include "memory.h"     // struct memory, NUM_OF_PROCESSES
+
+#define SCHED_BATCH 256     // Max references run by a single memory request
+
+/* CPU scheduling policy:                                               *
+ * RR_QUANTUM:   Round-robin, a process is preempted after q references *
+ * FAULT_SWITCH: A process keeps the CPU until it page faults           *
+ * PRIORITY:     Highest priority ready process runs, ties are RR       */
+enum sched_policy { RR_QUANTUM, FAULT_SWITCH, PRIORITY };
+
+enum proc_state { PROC_READY, PROC_RUNNING, PROC_BLOCKED, PROC_INPUT, PROC_SUSPENDED, PROC_DONE };
+
+/* REF_END:   The source has no more references                 *
+ * REF_OK:    A reference was fetched                           *
+ * REF_AGAIN: Nothing to fetch until another process runs       *
+ * REF_ERROR: The source couldn't be read, or is corrupt        */
+enum ref_status { REF_END, REF_OK, REF_AGAIN, REF_ERROR };
+
+
+/* Fetches the next reference of a process from the source `src`. *
+ * Returns an `enum ref_status`.                                   */
+typedef int (*ref_source)(void *src, uint32_t *paddr, char *pmode);
+
+
+struct scheduler;
+
+/* Called by the scheduler between two time slices, with `arg` given in the config. */
+typedef void (*sched_hook)(struct scheduler *s, struct memory *mem, void *arg);
+
+
+struct sched_config
+{
+  enum sched_policy policy;
+  size_t quantum;             // References per time slice (q)
+  size_t disk_lat;            // Ticks a faulting process stays blocked
+  size_t cs_cost;             // Ticks spent on every context switch
+  size_t max_refs;            // Stop after this many references, 0 for no limit
+
+  double lc_max_pf;           // Fault rate considered thrashing, 0 disables load control
+  size_t lc_window;           // References between two load control checks
+
+  size_t report_every;        // References between interim stats, 0 for none
+  sched_hook report;          // Reports interim stats, NULL for none
+  void  *report_arg;
+
+  size_t ckpt_every;          // References between two checkpoints, 0 for none
+  sched_hook ckpt;            // Writes a checkpoint, also once when the run stops, NULL for none
+  void  *ckpt_arg;
+};
+
+
+// Process Control Block
+struct process
+{
+  uint8_t pid;
+  int     prio;               // Greater value, greater priority
+  enum proc_state state;
+  void   *src;                // Source of the references of the process
+
+  size_t wake;                // Tick at which a blocked process becomes ready,
+                              // or # refs after which a process waiting for input does
+  size_t refs;                // # References executed
+  size_t faults;              // # Page faults
+  size_t dispatches;          // # Times it was given the CPU
+  size_t blocked_t;           // # Ticks spent waiting for the disk
+  size_t finish;              // Tick at which its trace ended
+
+  size_t need;                // Frames it needed when last suspended (see lc_check())
+  size_t susp_t;              // # Ticks spent suspended
+
+  uint32_t st_addrs[SCHED_BATCH];     // References read from `src`, not run yet
+  char     st_modes[SCHED_BATCH];
+  uint8_t  st_pids [SCHED_BATCH];     // Always `pid`
+  size_t   st_head;                   // Index of the next one to run
+  size_t   st_count;
+  bool     ended;                     // `src` has no more, once these run the process exits
+};
+
+
+// A period a process spent swapped out by the load control
+struct suspension
+{
+  uint8_t pid;
+  size_t start;               // Tick it was suspended
+  size_t end;                 // Tick it was resumed, 0 if still suspended
+  size_t freed;               // # Frames released
+};
+
+
+// Short-term scheduler. A reference costs 1 tick of CPU time.
+struct scheduler
+{
+  struct sched_config cfg;
+  struct process procs[NUM_OF_PROCESSES];
+  ref_source next_ref;
+
+  int curr;                   // Index of the running process, -1 if the CPU is idle
+  int last;                   // Index of the last process that ran
+  size_t slice;               // # References executed in the current time slice
+
+  size_t clock;               // Elapsed ticks
+  size_t busy;                // # Ticks spent executing references
+  size_t switch_t;            // # Ticks spent context switching
+  size_t ctx_switches;        // # Context switches
+  size_t refs;                // # References executed by every process
+
+  size_t lc_refs;             // # References since the last load control check
+  size_t lc_faults;           // # Page faults since the last load control check
+  size_t lc_starv;            // # Starvations seen by the last load control check
+
+  size_t next_ckpt;           // # References at which the next checkpoint is due
+
+  int error;                  // MEMSIM_ENOMEM once an allocation failed, else MEMSIM_OK
+
+  struct suspension *susp;    // Every suspension, in order
+  size_t n_susp;
+  size_t susp_cap;
+};
+
+
+/* Initializes the scheduler and returns a pointer to it.               *
+ * Requires: 1) Configuration 2) Array of PIDs 3) Array of priorities   *
+ * 4) Function reading a reference 5) Array of sources, one per PID     *
+ * Note: 3rd arg may be NULL, every process then has equal priority     *
+ * Returns NULL if out of memory.                                       */
+struct scheduler *sched_init(struct sched_config *cfg, uint8_t *pids, int *prios, ref_source next_ref, void **srcs);
+
+
+/* Runs the processes on `mem` until every trace ends or `max_refs` is reached. *
+ * Returns MEMSIM_OK, MEMSIM_ENOMEM if the run stopped out of memory, or       *
+ * MEMSIM_EIO if a trace couldn't be read.                                      */
+int  sched_run(struct scheduler *s, struct memory *mem);
+
+
+/* Deallocates the scheduler. Sources are owned by the caller. */
+void sched_clean(struct scheduler *s);
+
+
+#endif
@@ -1,42 +1,80 @@
 /* simulator.c */
-#include <errno.h>        // perror
+#include <errno.h>        // perror, errno, ERANGE
+#include <limits.h>       // ULONG_MAX
 #include <stdbool.h>      // bool
 #include <stdint.h>       // int32, int8
 #include <stdio.h>
 #include <stdlib.h>       // atoi, exit
 #include <string.h>       // strcpy
+#include <sys/stat.h>     // stat, S_ISREG, S_ISBLK
+#include <unistd.h>       // getopt, lseek
 
-#include "memory.h"       // enum algorithm, NUM_OF_PROCESSES
+#include "checkpoint.h"   // ckpt_*()
+#include "memsim.h"       // memsim_*(), enum algorithm, enum sched_policy
+#include "page_table.h"   // pt_name()
+#include "shards.h"       // shards_*()
+#include "trace.h"        // trace_*(), mux_*()
+#include "ws_curve.h"     // wsc_*()
 
 #define PATH1 "./traces/bzip.trace"   /* 1st file of memory traces */
 #define PATH2 "./traces/gcc.trace"    /* 2nd file of memory traces */
 
+#define MAX_SEGMENTS 16                 /* Shared segments given with -X */
+
 enum error_t
 { 
   INVALID_NUM_ARGS,      /* Input errors */
   INVALID_ALG, 
-  WS_NO_WINDOW_S 
+  WS_NO_WINDOW_S,
+  INVALID_SCHED,
+  INVALID_PRIO,
+  NO_QUANTUM,
+  INVALID_LC,
+  TOO_MANY_TRACES,
+  NO_CKPT_PATH,
+  CKPT_NOT_SEEKABLE,
+  INVALID_RATE,
+  NO_MAX_WINDOW,
+  INVALID_SEGMENT,
+  INVALID_PAGE_SIZE,
+  INVALID_PAGE_TABLE,
+  PAGE_TABLE_ALONE,
+  FULL_RUN_ONLY
 };
 
 /* ========================================================================== */
 
-/* Opens a file and performs error handling. *
- * Return a pointer to the file.             */
-static FILE *file_open(char *path);
-
-/* Closes a file and perfrorms error handling. */
-static void  file_close(FILE *f);
-
 /* Handle logic errors from the user's input. */
 static void  error_handle(enum error_t error);
 
-/* Print the setup configuration of the simulator. */
-static void  print_setup(char * alg, size_t q, size_t frames, size_t ws_wind, size_t max_refs);
+/* Whether the trace at `path` can be repositioned, as checkpoints need.
+ * A missing file passes, trace_open() reports it. */
+static bool  trace_seekable(const char *path);
+
+/* Restore a checkpoint in a fresh memory and scheduler, exits on failure. */
+static void  restore(char *path, struct memsim *sim, struct trace **traces);
+
+/* Report an error of the simulator library, and exit. */
+static void  sim_error(const char *what, int error);
+
+/* Print the stats of a run. */
+static void  print_stats(const struct memsim_stats *st);
+
+/* Print a one line summary of the run so far (a `sched_hook`). */
+static void  print_interim(struct scheduler *s, struct memory *mem, void *arg);
+
+/* Print the estimates of a sampled run. */
+static void  print_shards(const struct shards_results *r);
 
-/* Reads a reference and its mode (R/W) from a file. *
- * Stores the values to the pointers passed as args. *
- * Returns 0 if we reached the end of file, else 1.  */
-static int   read_ref(FILE *file, uint32_t *paddr, char *pmode);
+/* Write the Working Set curves to a CSV file, and print the largest *
+ * window whose Working Sets fit in the frames. Exits on failure.    */
+static void  print_ws_curves(struct ws_curve *c, char *path, size_t frames);
+
+/* Close the stream, or the traces. */
+static void  close_inputs(struct trace_mux *mux, struct trace **traces);
+
+/* Print the setup configuration of the simulator. */
+static void  print_setup(char * alg, size_t q, size_t frames, size_t ws_wind, size_t max_refs, struct sched_config *sc, double sample_rate, struct memsim_config *mc);
 
 /* ========================================================================== */
 
@@ -46,9 +84,50 @@ static int   read_ref(FILE *file, uint32_t *paddr, char *pmode);
  * 3) Set of q refs to be read       *
  * 4) Working Set window             *
  * 5) Maximum references to be read  *
- * Note: 4-5 are optional args       */
-
-int main(int argc, char const *argv[])
+ * Note: 4-5 are optional args       *
+ * Options:                          *
+ * -s Scheduler {"rr", "fault", "prio"} *
+ * -d Disk latency of a fault (ticks)   *
+ * -c Context switch cost (ticks)       *
+ * -p Priorities, e.g. "2,1"            *
+ * -L Thrashing fault rate, enables     *
+ *    load control (suspensions)        *
+ * -W Load control window (refs)        *
+ * -t Trace of a process, once per PID  *
+ *    ("-" for stdin, or a named pipe)  *
+ * -m Stream of references tagged by    *
+ *    PID, instead of the traces        *
+ * -B Refs queued per PID from -m       *
+ * -i Interim stats every N refs        *
+ * -C Checkpoint file, written at the   *
+ *    end of the run (traces must be    *
+ *    files, or stdin redirected from   *
+ *    one, not pipes)                   *
+ * -n Also checkpoint every N refs      *
+ * -R Restore a checkpoint and go on    *
+ * -S Approximate run on the pages      *
+ *    sampled at this rate (SHARDS),    *
+ *    the scheduler options are ignored *
+ *    Estimates come with their 95%     *
+ *    confidence interval: a few % off  *
+ *    if a sample keeps hundreds of     *
+ *    pages, ~1% if thousands           *
+ * -M Max pages tracked per sample      *
+ * -A Write the Working Set fault rate  *
+ *    and size of every window, up to   *
+ *    the window given, to a CSV file   *
+ *    in one pass, and exit             *
+ * -X Addresses shared by every process *
+ *    e.g. "0x40000000-0x4fffffff"      *
+ * -F Processes forked from one parent: *
+ *    other pages shared copy-on-write  *
+ * -P Page size in bytes, e.g. 2M:      *
+ *    4K (default), 8K, 16K, 64K, 2M    *
+ * -T Page table to model, reporting    *
+ *    its memory and walk costs:        *
+ *    ipt, 2level, 4level, hashed       */
+
+int main(int argc, char *argv[])
 {
   char repl_alg[4];               // Replacement algorithm
   size_t q;  
@@ -56,6 +135,177 @@ int main(int argc, char const *argv[])
   size_t ws_wind  = 0;           // Working Set History window
   size_t max_refs = 0;           // Maximum # references
 
+  struct sched_config sc = { .policy = RR_QUANTUM };
+  int prios[NUM_OF_PROCESSES] = { 0 };
+  int opt;
+
+  char *paths[NUM_OF_PROCESSES] = { PATH1, PATH2 };     // Trace of each process
+  size_t n_paths = 0;
+  char *mux_path = NULL;          // Multiplexed stream, replaces the traces
+  size_t mux_cap = 0;
+
+  char *ckpt_path = NULL;         // Checkpoints written here
+  char *restore_path = NULL;      // Checkpoint the run starts from
+
+  double sample_rate = 0;         // Sampled run, if positive
+  size_t sample_blocks = 0;
+
+  char *curves_path = NULL;       // Working Set curves written here
+
+  struct memsim_segment segs[MAX_SEGMENTS];     // Shared pages
+  size_t n_segs = 0;
+  bool forked = 0;
+
+  unsigned page_shift = 0;        // Pages of 2^page_shift bytes, 0 for the default
+  enum pt_kind page_table = PT_NONE;
+
+  while ((opt = getopt(argc, argv, "s:d:c:p:L:W:t:m:B:i:C:n:R:S:M:A:X:FP:T:")) != -1)
+  {                          // Decode the options
+    switch(opt)
+    {
+      case 's':
+        if (!strcmp(optarg, "rr"))
+          sc.policy = RR_QUANTUM;
+        else if (!strcmp(optarg, "fault"))
+          sc.policy = FAULT_SWITCH;
+        else if (!strcmp(optarg, "prio"))
+          sc.policy = PRIORITY;
+        else
+          error_handle(INVALID_SCHED);
+        break;
+
+      case 'd':
+        sc.disk_lat = atoi(optarg);
+        break;
+
+      case 'c':
+        sc.cs_cost = atoi(optarg);
+        break;
+
+      case 'p':
+      {
+        char *tok = strtok(optarg, ",");
+        for (size_t i = 0; i < NUM_OF_PROCESSES; ++i, tok = strtok(NULL, ","))
+        {
+          if (tok == NULL) error_handle(INVALID_PRIO);
+          prios[i] = atoi(tok);
+        }
+        break;
+      }
+
+      case 'L':
+        sc.lc_max_pf = atof(optarg);
+        if (sc.lc_max_pf <= 0 || sc.lc_max_pf > 1)
+          error_handle(INVALID_LC);
+        break;
+
+      case 'W':
+        sc.lc_window = atoi(optarg);
+        break;
+
+      case 't':
+        if (n_paths == NUM_OF_PROCESSES)
+          error_handle(TOO_MANY_TRACES);
+        paths[n_paths++] = optarg;
+        break;
+
+      case 'm':
+        mux_path = optarg;
+        break;
+
+      case 'B':
+        mux_cap = atoi(optarg);
+        break;
+
+      case 'i':
+        sc.report_every = atoi(optarg);
+        break;
+
+      case 'C':
+        ckpt_path = optarg;
+        break;
+
+      case 'n':
+        sc.ckpt_every = atoi(optarg);
+        break;
+
+      case 'R':
+        restore_path = optarg;
+        break;
+
+      case 'S':
+        sample_rate = atof(optarg);
+        if (sample_rate <= 0 || sample_rate > 1)
+          error_handle(INVALID_RATE);
+        break;
+
+      case 'M':
+        sample_blocks = atoi(optarg);
+        break;
+
+      case 'A':
+        curves_path = optarg;
+        break;
+
+      case 'X':
+      {
+        char *end;
+        if (n_segs == MAX_SEGMENTS) error_handle(INVALID_SEGMENT);
+
+        segs[n_segs].first = strtoul(optarg, &end, 16);
+        if (*end != '-') error_handle(INVALID_SEGMENT);
+
+        segs[n_segs].last = strtoul(end + 1, &end, 16);
+        if (*end != '\0' || segs[n_segs].first > segs[n_segs].last)
+          error_handle(INVALID_SEGMENT);
+
+        ++n_segs;
+        break;
+      }
+
+      case 'F':
+        forked = 1;
+        break;
+
+      case 'P':
+      {
+        char *end;
+        errno = 0;
+        unsigned long size = strtoul(optarg, &end, 10);
+        unsigned long unit = (*end == 'K' ? 1ul << 10 : (*end == 'M' ? 1ul << 20 : 1));
+
+        if (unit > 1) ++end;
+
+        if (*end != '\0' || errno == ERANGE || size > ULONG_MAX / unit)
+          error_handle(INVALID_PAGE_SIZE);
+
+        page_shift = mem_page_shift_of(size * unit);
+        if (page_shift == 0)
+          error_handle(INVALID_PAGE_SIZE);
+        break;
+      }
+
+      case 'T':
+        if (!strcmp(optarg, "ipt"))
+          page_table = PT_IPT;
+        else if (!strcmp(optarg, "2level"))
+          page_table = PT_RADIX2;
+        else if (!strcmp(optarg, "4level"))
+          page_table = PT_RADIX4;
+        else if (!strcmp(optarg, "hashed"))
+          page_table = PT_HASHED;
+        else
+          error_handle(INVALID_PAGE_TABLE);
+        break;
+
+      default:
+        error_handle(INVALID_NUM_ARGS);
+    }
+  }
+
+  argc -= optind - 1;           // Leave only the positional arguments
+  argv += optind - 1;
+
   switch(argc)
   {                          // Decode the command line arguments
     case 6:
@@ -65,7 +315,8 @@ int main(int argc, char const *argv[])
     case 4:
       q = atoi(argv[3]);
       frames = atoi(argv[2]);
-      strcpy(repl_alg, argv[1]);
+      strncpy(repl_alg, argv[1], sizeof(repl_alg) - 1);
+      repl_alg[sizeof(repl_alg) - 1] = '\0';
       break;
 
     default: 
@@ -84,58 +335,206 @@ int main(int argc, char const *argv[])
   if (page_repl == WS && ws_wind == 0) 
     error_handle(WS_NO_WINDOW_S);
 
-  print_setup(repl_alg, q, frames, ws_wind, max_refs);
+  if (q == 0 && sc.policy != FAULT_SWITCH)
+    error_handle(NO_QUANTUM);
+
+  if (curves_path && ws_wind == 0)
+    error_handle(NO_MAX_WINDOW);
+
+  bool big_pages = (page_shift && page_shift != OFFSET_BITS);    // Only 4K is sampled/analysed
+
+  if ((n_segs || forked || big_pages || page_table) && (sample_rate > 0 || curves_path))
+    error_handle(FULL_RUN_ONLY);
+
+  if (page_table && (n_segs || forked || ckpt_path || restore_path))
+    error_handle(PAGE_TABLE_ALONE);
+
+  if (sc.ckpt_every && ckpt_path == NULL)
+    error_handle(NO_CKPT_PATH);
+
+  if ((ckpt_path || restore_path) && mux_path)
+    error_handle(CKPT_NOT_SEEKABLE);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES && (ckpt_path || restore_path); ++i)
+  {
+    if (!trace_seekable(paths[i]))      // Else the run would only fail once it ends
+      error_handle(CKPT_NOT_SEEKABLE);
+  }
+
+  sc.quantum  = q;
+  sc.max_refs = max_refs;
+
+  struct memsim_config mc = { .alg = page_repl, .frames = frames, .ws_window = ws_wind, .sched = sc,
+                              .segs = segs, .n_segs = n_segs, .forked = forked, .page_shift = page_shift,
+                              .page_table = page_table };
+
+  print_setup(repl_alg, q, frames, ws_wind, max_refs, &sc, sample_rate, &mc);
 
   printf("\n\033[0;31m> Beginning the simulation!\n>\n");
 
   uint8_t pids[NUM_OF_PROCESSES] = { 0, 1 };        //* Specify PIDs tracked
 
-  // Initialize memory segment
-  struct memory *my_mem = mem_init(frames, page_repl, pids, ws_wind);
-
-  FILE *tr1 = file_open(PATH1);
-  FILE *tr2 = file_open(PATH2);
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    mc.pids[i]  = pids[i];
+    mc.prios[i] = prios[i];
+  }
 
-  size_t refs_rd = 0;         // References read
-  bool end = 0;               // EOF Check
+  struct trace *traces[NUM_OF_PROCESSES] = { NULL };
+  struct trace_mux *mux = NULL;
 
+  void *srcs[NUM_OF_PROCESSES];       // Source of references of each process
+  ref_source read_ref;
 
-  while (refs_rd < max_refs || max_refs == 0)
-  {                             // Loop while max_refs is not specified or we haven't reached it
-    uint32_t addr;
-    char mode;           // 'R' or 'W'
-    
-    for (size_t i = 0; i < q; ++i)           // Read a total of q references every time
+  if (mux_path)
+  {                                   // Online: records of every PID in one stream
+    mux = mux_open(mux_path, pids, mux_cap);
+    if (mux == NULL)
     {
-      if (read_ref(tr1, &addr, &mode) == 0 && (end = 1))
-        break;
+      perror(mux_path);
+      exit(EXIT_FAILURE);
+    }
+    read_ref = mux_read;
 
-      ++refs_rd;
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+      srcs[i] = &mux->ports[i];
+  }
+  else
+  {
+    read_ref = trace_read;
 
-      mem_retrieve(my_mem, addr, mode, pids[0]);    // Retrieve address from memory
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      srcs[i] = traces[i] = trace_open(paths[i]);
+      if (traces[i] == NULL)
+      {
+        perror(paths[i]);
+        exit(EXIT_FAILURE);
+      }
     }
+  }
 
-    for (size_t i = 0; i < q; ++i)
-    {
-      if (read_ref(tr2, &addr, &mode) == 0 && (end = 1))
-        break;
+  if (curves_path)
+  {                           // Every window at once, instead of a run per window
+    struct ws_curve *c = wsc_init(pids, ws_wind);
+    if (c == NULL)
+      sim_error("set up the Working Set curves", MEMSIM_ENOMEM);
 
-      ++refs_rd;
+    int error = wsc_run(c, read_ref, srcs, q, max_refs);
+    if (error != MEMSIM_OK)
+      sim_error("compute the Working Set curves", error);
 
-      mem_retrieve(my_mem, addr, mode, pids[1]);
-    }
+    printf(">\n> Analysis just ended!\033[0m\n\n");
 
-    if (end == 1) break;        // We reached EOF in at least 1 file
+    print_ws_curves(c, curves_path, frames);
+
+    wsc_clean(c);
+    close_inputs(mux, traces);
+    return EXIT_SUCCESS;
   }
 
+  if (sample_rate > 0)
+  {                           // Estimate from a sample instead of simulating everything
+    struct shards *sh = shards_init(frames, page_repl, pids, ws_wind, sample_rate, sample_blocks);
+    if (sh == NULL)
+      sim_error("set up the sampled simulation", MEMSIM_ENOMEM);
+
+    int error = shards_run(sh, read_ref, srcs, pids, q, max_refs);
+    if (error != MEMSIM_OK)
+      sim_error("finish the sampled simulation", error);
+
+    printf(">\n> Simulation just ended!\033[0m\n\n");
+
+    struct shards_results results;
+    shards_results(sh, &results);
+    print_shards(&results);
+
+    shards_clean(sh);
+    close_inputs(mux, traces);
+    return EXIT_SUCCESS;
+  }
+
+  if (mc.sched.report_every)
+    mc.sched.report = print_interim;
+
+  struct ckpt_target target = { .path = ckpt_path, .traces = traces };
+  if (ckpt_path)
+  {
+    mc.sched.ckpt = ckpt_hook;
+    mc.sched.ckpt_arg = &target;
+  }
+
+  struct memsim sim;
+  struct memsim_stats stats;
+  int error;
+
+  size_t base_refs  = 0;      // Run without load control, to compare with
+  size_t base_clock = 0;
+
+  bool replay = (mux == NULL);    // Only files can be read twice
+  for (size_t i = 0; replay && i < NUM_OF_PROCESSES; ++i)
+    replay = (trace_rewind(traces[i]) == 1);
+
+  if (sc.lc_max_pf > 0 && !replay)
+    printf("> Inputs can't be replayed, no run without load control to compare with\n>\n");
+
+  if (sc.lc_max_pf > 0 && replay)
+  {                           // Let everything thrash first
+    struct memsim_config thrash = mc;
+    thrash.sched.lc_max_pf = 0;
+    thrash.sched.ckpt_every = 0;
+    thrash.sched.ckpt = NULL;
+
+    if ((error = memsim_init(&sim, &thrash, read_ref, srcs)) != MEMSIM_OK)
+      sim_error("set up the run without load control", error);
+
+    if (restore_path)         // Both runs go on from the same state
+      restore(restore_path, &sim, traces);
+
+    if ((error = memsim_run(&sim)) != MEMSIM_OK)
+      sim_error("finish the run without load control", error);
+
+    memsim_get_stats(&sim, &stats);
+    base_refs  = stats.refs;
+    base_clock = stats.clock;
+
+    memsim_clean(&sim);
+
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+      trace_rewind(traces[i]);      // Replay the same traces
+  }
+
+  // Each process runs its trace; faults block it while the others keep the CPU
+  if ((error = memsim_init(&sim, &mc, read_ref, srcs)) != MEMSIM_OK)
+    sim_error("set up the simulation", error);
+
+  if (restore_path)
+    restore(restore_path, &sim, traces);
+
+  if ((error = memsim_run(&sim)) != MEMSIM_OK)
+    sim_error("finish the simulation", error);
+
   printf(">\n> Simulation just ended!\033[0m\n\n");
 
-  mem_stats(my_mem);            // Print stats
+  memsim_get_stats(&sim, &stats);
+  print_stats(&stats);            // Print stats
+
+  if (target.error != CKPT_OK)
+    fprintf(stderr, "> Checkpoint at %lu refs failed: %s\n\n", target.error_refs, ckpt_strerror(target.error));
+
+  if (base_clock && stats.clock)
+  {
+    double before = (double) base_refs / base_clock;
+    double after  = (double) stats.refs / stats.clock;
+
+    printf("\033[0;36m    Throughput without load control\033[0m = %1.6lf refs/tick\n", before);
+    printf("\033[0;36m    Throughput with load control\033[0m    = %1.6lf refs/tick (%+.2lf%%)\n\n",
+      after, 100.0 * (after - before) / before);
+  }
 
-  mem_clean(my_mem);            // Cleanup the memory used 
+  memsim_clean(&sim);           // Cleanup the memory used 
 
-  file_close(tr1);
-  file_close(tr2);
+  close_inputs(mux, traces);
   
   return EXIT_SUCCESS;
 }
@@ -161,50 +560,360 @@ static void error_handle(enum error_t error)
       fprintf(stderr, "Working Set algorithm was chosen, \
 but no window size specified.\n");
       break;
+
+    case INVALID_SCHED:
+      fprintf(stderr, "Invalid scheduling policy given. \
+\n  Options are: { rr, fault, prio }, case sensitive!\n");
+      break;
+
+    case INVALID_PRIO:
+      fprintf(stderr, "A priority must be given for every process.\n");
+      break;
+
+    case NO_QUANTUM:
+      fprintf(stderr, "q must be positive, unless the fault scheduler is used.\n");
+      break;
+
+    case INVALID_LC:
+      fprintf(stderr, "The thrashing fault rate must be in (0, 1].\n");
+      break;
+
+    case TOO_MANY_TRACES:
+      fprintf(stderr, "More traces given than processes tracked.\n");
+      break;
+
+    case NO_CKPT_PATH:
+      fprintf(stderr, "A checkpoint interval was given, but no checkpoint file.\n");
+      break;
+
+    case CKPT_NOT_SEEKABLE:
+      fprintf(stderr, "Checkpoints need traces that can be repositioned, \
+not a stream or a pipe.\n");
+      break;
+
+    case INVALID_RATE:
+      fprintf(stderr, "The sampling rate must be in (0, 1].\n");
+      break;
+
+    case INVALID_SEGMENT:
+      fprintf(stderr, "Invalid shared segment, give its first and last hex addresses, \
+e.g. 0x1000-0x1fff (at most %d).\n", MAX_SEGMENTS);
+      break;
+
+    case INVALID_PAGE_SIZE:
+      fprintf(stderr, "Invalid page size given. \
+\n  Options are: { 4K, 8K, 16K, 64K, 2M }, in bytes or with a K/M suffix.\n");
+      break;
+
+    case INVALID_PAGE_TABLE:
+      fprintf(stderr, "Invalid page table given. \
+\n  Options are: { ipt, 2level, 4level, hashed }, case sensitive!\n");
+      break;
+
+    case PAGE_TABLE_ALONE:
+      fprintf(stderr, "Page tables are modelled for private pages, without checkpoints: \
+not with -X, -F, -C or -R.\n");
+      break;
+
+    case FULL_RUN_ONLY:
+      fprintf(stderr, "Shared pages, page sizes other than 4K and page tables are only \
+simulated in full, not sampled or analysed.\n");
+      break;
+
+    case NO_MAX_WINDOW:
+      fprintf(stderr, "Working Set curves were asked for, \
+but no window size to compute them up to.\n");
+      break;
   }
 
-  fprintf(stderr, "> Usage:\n$ ./mem_sim\n<page_replacent_algorithm>\n<frames>\n\
+  fprintf(stderr, "> Usage:\n$ ./mem_sim [-s rr|fault|prio] [-d disk_latency] \
+[-c switch_cost] [-p prio,prio]\n  [-L thrashing_fault_rate] [-W load_control_window] \
+[-t trace]... [-m stream] [-B queued_refs] [-i interim_every]\n  \
+[-C checkpoint [-n checkpoint_every]] [-R checkpoint] [-S rate [-M max_pages]] [-A curves.csv]\n  [-X first-last]... [-F] [-P page_size] [-T page_table]\n<page_replacent_algorithm>\n<frames>\n\
 <q>\n<window_size>\n<max_references>\n\n");
   exit(EXIT_FAILURE);
 }
 
 /* ========================================================================== */
 
-static int read_ref(FILE *file, uint32_t *paddr, char *pmode)
+static bool  trace_seekable(const char *path)
 {
-  if (feof(file)) return 0;
+  if (!strcmp(path, "-"))
+    return (lseek(STDIN_FILENO, 0, SEEK_CUR) != -1);    // stdin redirected from a file
 
-  fscanf(file, "%x ", paddr);
-  fscanf(file, "%c ", pmode);
+  struct stat st;
 
-  return 1;
+  if (stat(path, &st) == -1)
+    return 1;
+
+  return (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode));   // Not a pipe, FIFO or socket
 }
+
 /* ========================================================================== */
 
-static FILE *file_open(char *path)
+static void  restore(char *path, struct memsim *sim, struct trace **traces)
 {
-  FILE *f = fopen(path, "r");
-  if (f == NULL)
+  int error = ckpt_load(path, sim->mem, sim->sched, traces);
+
+  if (error != CKPT_OK)
   {
-    perror("fopen");
+    fprintf(stderr, "\n> Couldn't restore checkpoint %s: %s\n", path, ckpt_strerror(error));
     exit(EXIT_FAILURE);
   }
-  return f;
+
+  printf("> Restored checkpoint %s at %lu references\n>\n", path, sim->sched->refs);
+}
+
+/* ========================================================================== */
+
+static void  sim_error(const char *what, int error)
+{
+  fprintf(stderr, "\n> Couldn't %s: %s\n", what, memsim_strerror(error));
+  exit(EXIT_FAILURE);
 }
+
 /* ========================================================================== */
 
-static void file_close(FILE *f)
+static void  print_stats(const struct memsim_stats *st)
 {
-  if (fclose(f) != 0)
+  char red[] = "\033[0;31m";
+  char yel[] = "\033[0;33m";
+  char cyn[] = "\033[0;36m";
+  char res[] = "\033[0m";
+
+  printf("> Printing simulation results!\n");
+  printf("\n%s    Page Fault Rate%s = %1.6lf\n\n", 
+    cyn, res, (double) st->page_fs / st->requests );
+  
+  printf("%s    Page Faults:%s %lu\n",       red, res, st->page_fs  );
+  printf("%s    HardDrive Reads:%s %lu\n",   yel, res, st->hd_reads );
+  printf("%s    HardDrive Writes:%s %lu\n",  yel, res, st->hd_writes);
+
+  if (st->starvations)
+    printf("%s    Starvations:%s %lu\n",    red, res, st->starvations);
+  printf("\n");
+
+  if (st->sharing)
+  {
+    printf("%s    Copy-on-write faults:%s %lu\n", red, res, st->cow_faults);
+    printf("%s    Faults avoided by sharing:%s %lu\n", yel, res, st->shared_hits);
+    printf("%s    Frames saved by sharing:%s %lu at the end, %lu at most\n\n",
+      yel, res, st->frames_saved, st->peak_saved);
+  }
+
+  if (st->page_table != PT_NONE)
   {
-    perror("fclose");
+    printf("%s    Page table (%s):%s %lu bytes at the end, %lu at most\n",
+      yel, pt_name(st->page_table), res, st->pt_bytes, st->pt_peak_bytes);
+    printf("%s    Memory accesses per translation:%s %.3lf\n",
+      yel, res, st->pt_translations ? (double) st->pt_accesses / st->pt_translations : 0.0);
+
+    if (st->walk_lookups)
+      printf("%s    Walk cache hit rate:%s %1.6lf\n",
+        yel, res, (double) st->walk_hits / st->walk_lookups);
+    printf("\n");
+  }
+
+  char *policy[] = { "Round-Robin", "Switch on Fault", "Priority" };
+
+  size_t idle_t = st->clock - st->busy - st->switch_t;
+
+  printf("> Printing scheduler results!\n");
+  printf("\n%s    CPU Utilisation%s = %1.6lf\n\n",
+    cyn, res, st->clock ? (double) st->busy / st->clock : 0.0);
+
+  printf("%s    Scheduling policy:%s %s\n",  yel, res, policy[st->policy]);
+  printf("%s    Elapsed ticks:%s %lu\n",     yel, res, st->clock);
+  printf("%s    Idle ticks:%s %lu\n",        yel, res, idle_t);
+  printf("%s    Context switches:%s %lu (%lu ticks)\n\n", yel, res, st->ctx_switches, st->switch_t);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    const struct memsim_proc_stats *p = &st->procs[i];
+
+    printf("%s    Process %u:%s %lu refs, %lu faults, %lu dispatches, %lu ticks blocked\n",
+      yel, p->pid, res, p->refs, p->faults, p->dispatches, p->blocked_t);
+    printf("      Throughput = %1.6lf refs/tick\n",
+      st->clock ? (double) p->refs / st->clock : 0.0);
+
+    if (p->susp_t)
+      printf("      Suspended for %lu ticks\n", p->susp_t);
+  }
+  printf("\n");
+
+  if (st->n_susp == 0) return;
+
+  printf("%s    Suspensions:%s %lu\n", yel, res, st->n_susp);
+
+  for (size_t i = 0; i < st->n_susp; ++i)
+    printf("      Process %u: ticks [%lu, %lu), %lu frames released\n",
+      st->susp[i].pid, st->susp[i].start, st->susp[i].end, st->susp[i].freed);
+  printf("\n");
+}
+
+/* ========================================================================== */
+
+static void  print_interim(struct scheduler *s, struct memory *mem, void *arg)
+{
+  (void) arg;
+
+  printf("> [%lu refs] Page Fault Rate = %1.6lf, CPU Utilisation = %1.6lf,",
+    s->refs, mem->total_req ? (double) mem->page_fs / mem->total_req : 0.0,
+    s->clock ? (double) s->busy / s->clock : 0.0);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    printf(" P%u: %lu refs", s->procs[i].pid, s->procs[i].refs);
+
+  printf("\n");
+  fflush(stdout);             // Visible while the run goes on
+}
+
+/* ========================================================================== */
+
+static void  print_shards(const struct shards_results *r)
+{
+  char red[] = "\033[0;31m";
+  char yel[] = "\033[0;33m";
+  char cyn[] = "\033[0;36m";
+  char res[] = "\033[0m";
+
+  printf("> Printing sampled simulation results!\n");
+  printf("  (estimates are the mean of %d samples, ± its 95%% confidence interval)\n", SHARDS_SAMPLES);
+
+  printf("\n%s    Page Fault Rate%s = %1.6lf ± %1.6lf\n\n", cyn, res,
+    r->refs ? r->page_fs.mean / r->refs : 0.0, r->refs ? r->page_fs.ci / r->refs : 0.0);
+
+  printf("%s    Page Faults:%s %.0lf ± %.0lf (%.1lf%%)\n", red, res, r->page_fs.mean, r->page_fs.ci,
+    r->page_fs.mean > 0 ? 100 * r->page_fs.ci / r->page_fs.mean : 0.0);
+  printf("%s    HardDrive Reads:%s %.0lf ± %.0lf\n",    yel, res, r->page_fs.mean,   r->page_fs.ci);
+  printf("%s    HardDrive Writes:%s %.0lf ± %.0lf\n\n", yel, res, r->hd_writes.mean, r->hd_writes.ci);
+
+  printf("%s    References:%s %lu read, %lu sampled (rate %1.4lf)\n",
+    yel, res, r->refs, r->sampled, r->rate);
+  printf("%s    LRU miss ratio curve:%s rate %1.4lf, %lu pages tracked at most\n\n",
+    yel, res, r->mrc_rate, r->max_tracked);
+
+  printf("      %10s   %s\n", "Frames", "Miss ratio");
+
+  for (size_t k = 0; k < SHARDS_MRC_POINTS; ++k)
+  {
+    if (r->mrc_frames[k] == 0) continue;
+    printf("      %10lu   %1.6lf ± %1.6lf\n", r->mrc_frames[k], r->mrc[k].mean, r->mrc[k].ci);
+  }
+  printf("\n");
+}
+
+/* ========================================================================== */
+
+static void  print_ws_curves(struct ws_curve *c, char *path, size_t frames)
+{
+  char yel[] = "\033[0;33m";
+  char cyn[] = "\033[0;36m";
+  char res[] = "\033[0m";
+
+  size_t max = c->max_window;
+  double *m[NUM_OF_PROCESSES];
+  double *s[NUM_OF_PROCESSES];
+  size_t refs = 0;
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    m[i] = malloc((max + 1) * sizeof(double));
+    s[i] = malloc((max + 1) * sizeof(double));
+    if (m[i] == NULL || s[i] == NULL)
+      sim_error("compute the Working Set curves", MEMSIM_ENOMEM);
+
+    wsc_curves(c, i, m[i], s[i]);
+    refs += c->procs[i].refs;
+  }
+
+  FILE *csv = fopen(path, "w");
+  if (csv == NULL)
+  {
+    perror(path);
     exit(EXIT_FAILURE);
   }
+
+  fprintf(csv, "window");
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    fprintf(csv, ",p%u_fault_rate,p%u_ws_size", c->procs[i].pid, c->procs[i].pid);
+  fprintf(csv, ",fault_rate,ws_size\n");
+
+  size_t best = 0;            // Largest window fitting in the frames
+  double best_m = 1.0, best_s = 0.0;
+
+  for (size_t T = 1; T <= max; ++T)
+  {
+    double faults = 0.0, size = 0.0;      // Of every process, windows are per process
+
+    fprintf(csv, "%lu", T);
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    {
+      fprintf(csv, ",%.6lf,%.3lf", m[i][T], s[i][T]);
+      faults += m[i][T] * c->procs[i].refs;
+      size   += s[i][T];
+    }
+    double rate = refs ? faults / refs : 0.0;
+    fprintf(csv, ",%.6lf,%.3lf\n", rate, size);
+
+    if (size <= frames)
+    {
+      best = T;
+      best_m = rate;
+      best_s = size;
+    }
+  }
+
+  if (fclose(csv) != 0)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("> Printing Working Set curves!\n");
+  printf("\n%s    Windows 1 to %lu written to%s %s\n\n", cyn, max, res, path);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+    printf("%s    Process %u:%s %lu refs, %lu distinct pages\n",
+      yel, c->procs[i].pid, res, c->procs[i].refs, c->procs[i].pages);
+
+  if (best)
+    printf("\n%s    Largest window fitting in %lu frames:%s %lu\n"
+      "      Mean Working Set size = %.1lf frames, Fault Rate = %1.6lf\n\n",
+      yel, frames, res, best, best_s, best_m);
+  else
+    printf("\n%s    No window fits in %lu frames%s\n\n", yel, frames, res);
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    free(m[i]);
+    free(s[i]);
+  }
+}
+
+/* ========================================================================== */
+
+static void  close_inputs(struct trace_mux *mux, struct trace **traces)
+{
+  if (mux)
+  {
+    if (mux->unknown)
+      printf("> %lu references of untracked PIDs were dropped\n\n", mux->unknown);
+    mux_close(mux);
+  }
+  else
+  {
+    for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+      trace_close(traces[i]);
+  }
 }
+
 /* ========================================================================== */
 
-static void  print_setup(char * alg, size_t q, size_t frames, size_t ws_wind, size_t max_refs)
+static void  print_setup(char * alg, size_t q, size_t frames, size_t ws_wind, size_t max_refs, struct sched_config *sc, double sample_rate, struct memsim_config *mc)
 {
+  char *policy[] = { "rr", "fault", "prio" };
+
   char yel[] = "\033[0;33m";  // yellow
   char res[] = "\033[0m";
 
@@ -212,6 +921,10 @@ static void  print_setup(char * alg, size_t q, size_t frames, size_t ws_wind, si
   printf("%s    Page replacement algorithm:%s %s\n", yel, res, alg);
   printf("%s    References read each time from each file (q):%s %lu\n", yel, res, q);
   printf("%s    Frames:%s %lu\n", yel, res, frames);
+
+  if (mc->page_shift)
+    printf("%s    Page size:%s %lu%s\n", yel, res,
+      mc->page_shift >= 20 ? 1ul << (mc->page_shift - 20) : 1ul << (mc->page_shift - 10), mc->page_shift >= 20 ? "MB" : "KB");
   
   if (ws_wind) printf("%s    Working Set window:%s %lu\n", yel, res, ws_wind);
 
@@ -220,5 +933,25 @@ static void  print_setup(char * alg, size_t q, size_t frames, size_t ws_wind, si
     printf("%lu\n", max_refs);
   else
     printf("No Limit\n");
+
+  printf("%s    Scheduler:%s %s\n", yel, res, policy[sc->policy]);
+  printf("%s    Disk latency (ticks):%s %lu\n", yel, res, sc->disk_lat);
+  printf("%s    Context switch cost (ticks):%s %lu\n", yel, res, sc->cs_cost);
+
+  if (sc->lc_max_pf > 0)
+    printf("%s    Load control:%s fault rate > %.3lf over %lu refs\n", 
+      yel, res, sc->lc_max_pf, sc->lc_window ? sc->lc_window : 1000);
+
+  if (sample_rate > 0)
+    printf("%s    Sampling rate (SHARDS):%s %.4lf\n", yel, res, sample_rate);
+
+  for (size_t i = 0; i < mc->n_segs; ++i)
+    printf("%s    Shared segment:%s 0x%08x-0x%08x\n", yel, res, mc->segs[i].first, mc->segs[i].last);
+
+  if (mc->forked)
+    printf("%s    Forked processes:%s other pages shared copy-on-write\n", yel, res);
+
+  if (mc->page_table != PT_NONE)
+    printf("%s    Page table:%s %s\n", yel, res, pt_name(mc->page_table));
 }
 /* ========================================================================== */
\ No newline at end of file
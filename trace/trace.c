@@ -0,0 +1,796 @@
+/* trace.c */
+#include <errno.h>        // errno, EINTR, ENOMEM, ENOTSUP, EIO
+#include <fcntl.h>        // open
+#include <pthread.h>      // pthread_create, pthread_join
+#include <sched.h>        // sched_yield
+#include <stdatomic.h>    // atomic_load_explicit, atomic_store_explicit
+#include <stdbool.h>      // bool
+#include <stdint.h>       // uint8_t, uint32_t, size_t
+#include <stdlib.h>       // malloc, calloc, free, strtoul
+#include <string.h>       // strcmp, memchr, memmove, memcpy
+#include <time.h>         // nanosleep
+#include <unistd.h>       // read, lseek, close
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>         // inflate*()
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>         // ZSTD_*DCtx(), ZSTD_decompressStream()
+#endif
+
+#include "scheduler.h"    // enum ref_status
+#include "trace.h"
+
+
+// Opens an input and starts its reader thread. NULL on failure, errno is set.
+static struct trace *open_input(const char *path, bool tagged);
+
+// Reader thread: decodes the input into batches until it ends or is stopped.
+static void *reader_main(void *arg);
+
+// Starts/Stops the reader thread of a trace. Starting returns 0 on failure, errno is set.
+static int   reader_start(struct trace *t);
+static void  reader_stop (struct trace *t);
+
+// Decodes the next reference of the input. Returns 0 at the end of it.
+static int   decode_ref(struct trace *t, uint32_t *ppid, uint32_t *paddr, char *pmode);
+
+// Finds the next non empty line of the input. Returns NULL at the end of it.
+static char *next_line(struct trace *t);
+
+// Tells the format of the input from its first bytes, and sets up its decompressor.
+// Returns 0 on failure, errno is set.
+static int   input_detect(struct trace *t);
+
+// Reads up to `n` bytes of the input, decompressed. Returns # bytes, 0 at the end, -1 on error
+// (EIO if the input ends in the middle of a compressed stream).
+static ssize_t input_read(struct trace *t, char *dst, size_t n);
+
+// Decompresses a compressed input again from its start, up to offset `off`. Returns 0 on failure.
+static int   input_restart(struct trace *t, uint64_t off);
+
+// Reads more of the file when `raw` is consumed. Returns # bytes in it, 0 at the end, -1 on error.
+static ssize_t raw_fill(struct trace *t);
+
+// Frees the decompressor.
+static void  input_end(struct trace *t);
+
+// Decodes "<hex address> <R|W>" starting from `str`. Returns 0 if malformed.
+static int   parse_ref(char *str, uint32_t *paddr, char *pmode);
+
+// Fetches the next reference consumed by the simulation. Returns 0 at the end,
+// -1 if the input couldn't be read to its end (errno is set).
+static int   trace_next(struct trace *t, uint32_t *ppid, uint32_t *paddr, char *pmode);
+
+// Waits a little longer every time it's called in a row.
+static void  backoff(unsigned *spins);
+
+// Places a record in the queue of process `index`. Returns 0 if it's full.
+static int   mux_push(struct trace_mux *mux, size_t index, uint32_t addr, char mode);
+
+// Matches a PID with the index of its queue, -1 if it isn't tracked.
+static int   mux_index(struct trace_mux *mux, unsigned long pid);
+
+/* ========================================================================== */
+
+struct trace *trace_open(const char *path)
+{
+  return open_input(path, 0);
+}
+
+/* ========================================================================== */
+
+int trace_read(void *trace, uint32_t *paddr, char *pmode)
+{
+  uint32_t pid;
+
+  int got = trace_next(trace, &pid, paddr, pmode);
+
+  return (got > 0 ? REF_OK : (got == 0 ? REF_END : REF_ERROR));
+}
+
+/* ========================================================================== */
+
+int trace_rewind(struct trace *t)
+{
+  return trace_seek(t, 0, 0);
+}
+
+/* ========================================================================== */
+
+void trace_tell(struct trace *t, uint64_t *poff, size_t *pskip)
+{
+  if (t->curr == NULL || t->next == t->curr->n)
+  {                                       // Right after a batch
+    *poff  = (t->curr ? t->curr->end : t->resume);
+    *pskip = 0;
+    return;
+  }
+
+  *poff  = t->curr->offset;
+  *pskip = t->next;
+}
+
+/* ========================================================================== */
+
+int trace_seek(struct trace *t, uint64_t off, size_t skip)
+{
+  if (!t->seekable)           // Pipes can't be replayed
+    return 0;
+
+  reader_stop(t);
+
+  bool moved = (t->format == TRACE_PLAIN ? lseek(t->fd, off, SEEK_SET) != -1 : input_restart(t, off));
+  if (!moved)
+  {
+    atomic_store(&t->end, 1);
+    return 0;
+  }
+  if (t->format == TRACE_PLAIN)
+    t->raw_pos = t->raw_len = 0;
+
+  t->pos = t->len = 0;
+  t->buf_off = t->resume = off;
+  t->curr = NULL;
+  t->refs = 0;
+  t->error = 0;
+  atomic_store(&t->head, 0);
+  atomic_store(&t->tail, 0);
+  atomic_store(&t->end, 0);
+
+  if (!reader_start(t))
+  {
+    atomic_store(&t->end, 1);       // Nothing more can be read
+    return 0;
+  }
+
+  uint32_t pid, addr;
+  char mode;
+
+  for (size_t i = 0; i < skip; ++i)       // Into the middle of the batch
+    trace_next(t, &pid, &addr, &mode);
+
+  t->refs = 0;
+  return 1;
+}
+
+/* ========================================================================== */
+
+void trace_close(struct trace *t)
+{
+  if (!t->seekable && t->running)
+    pthread_cancel(t->reader);    // It may wait for a writer that never comes
+
+  reader_stop(t);
+
+  if (t->fd != STDIN_FILENO)
+    close(t->fd);
+
+  input_end(t);
+  free(t->raw);
+  free(t->ring);
+  free(t->buf);
+  free(t);
+}
+
+/* ========================================================================== */
+
+static struct trace *open_input(const char *path, bool tagged)
+{
+  struct trace *t = calloc(1, sizeof(struct trace));
+  if (t == NULL) return NULL;
+
+  if (!strcmp(path, "-"))
+    t->fd = STDIN_FILENO;
+  else
+    t->fd = open(path, O_RDONLY);       // Blocks until a writer opens a named pipe
+
+  if (t->fd == -1)
+  {
+    free(t);
+    return NULL;
+  }
+
+  t->buf  = malloc(TRACE_BUF_SIZE);
+  t->raw  = malloc(TRACE_RAW_SIZE);
+  t->ring = malloc(TRACE_RING * sizeof(struct trace_batch));
+  if (t->buf == NULL || t->raw == NULL || t->ring == NULL)
+  {
+    errno = ENOMEM;
+    goto fail;
+  }
+
+  t->tagged   = tagged;
+  t->seekable = (lseek(t->fd, 0, SEEK_CUR) != -1);
+
+  if (t->seekable)
+    t->origin = lseek(t->fd, 0, SEEK_CUR);
+
+  if (!input_detect(t))
+    goto fail;
+
+  if (t->format == TRACE_PLAIN)     // Decompressed inputs count from 0
+    t->buf_off = t->resume = t->origin;
+
+  atomic_init(&t->head, 0);
+  atomic_init(&t->tail, 0);
+  atomic_init(&t->end,  0);
+  atomic_init(&t->stop, 0);
+
+  if (reader_start(t))
+    return t;
+
+fail:
+  if (t->fd != STDIN_FILENO)
+    close(t->fd);
+
+  input_end(t);
+  free(t->raw);
+  free(t->ring);
+  free(t->buf);
+  free(t);
+  return NULL;
+}
+
+/* ========================================================================== */
+
+static int reader_start(struct trace *t)
+{
+  atomic_store(&t->stop, 0);
+
+  int error = pthread_create(&t->reader, NULL, reader_main, t);
+  if (error == 0)
+    return (t->running = 1);
+
+  errno = error;
+  return 0;
+}
+
+/* ========================================================================== */
+
+static void reader_stop(struct trace *t)
+{
+  if (!t->running) return;
+
+  atomic_store(&t->stop, 1);
+  pthread_join(t->reader, NULL);
+  t->running = 0;
+}
+
+/* ========================================================================== */
+
+static void *reader_main(void *arg)
+{
+  struct trace *t = arg;
+
+  for (;;)
+  {
+    size_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    unsigned spins = 0;
+
+    while (tail - atomic_load_explicit(&t->head, memory_order_acquire) == TRACE_RING)
+    {                                   // Ring full, wait for the simulation
+      if (atomic_load_explicit(&t->stop, memory_order_relaxed))
+        return NULL;
+      backoff(&spins);
+    }
+
+    struct trace_batch *b = &t->ring[tail % TRACE_RING];
+    int more = 1;
+
+    b->offset = t->buf_off + t->pos;
+
+    for (b->n = 0; b->n < TRACE_BATCH; ++b->n)
+    {
+      more = decode_ref(t, &b->pids[b->n], &b->addrs[b->n], &b->modes[b->n]);
+      if (!more) break;
+    }
+
+    b->end = t->buf_off + t->pos;
+
+    if (b->n)                           // Publish the batch
+      atomic_store_explicit(&t->tail, tail + 1, memory_order_release);
+
+    if (!more)
+    {
+      atomic_store_explicit(&t->end, 1, memory_order_release);
+      return NULL;
+    }
+
+    if (atomic_load_explicit(&t->stop, memory_order_relaxed))
+      return NULL;
+  }
+}
+
+/* ========================================================================== */
+
+static int trace_next(struct trace *t, uint32_t *ppid, uint32_t *paddr, char *pmode)
+{
+  size_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+  if (t->curr && t->next == t->curr->n)
+  {                                     // Hand the batch back to the reader
+    t->resume = t->curr->end;
+    atomic_store_explicit(&t->head, ++head, memory_order_release);
+    t->curr = NULL;
+  }
+
+  if (t->curr == NULL)
+  {
+    unsigned spins = 0;
+
+    while (head == atomic_load_explicit(&t->tail, memory_order_acquire))
+    {                                   // Nothing decoded yet
+      if (atomic_load_explicit(&t->end, memory_order_acquire)
+          && head == atomic_load_explicit(&t->tail, memory_order_acquire))
+      {
+        if (t->error == 0) return 0;
+
+        errno = t->error;             // Set by the reader before the end
+        return -1;
+      }
+      backoff(&spins);
+    }
+
+    t->curr = &t->ring[head % TRACE_RING];
+    t->next = 0;
+  }
+
+  *ppid  = t->curr->pids [t->next];
+  *paddr = t->curr->addrs[t->next];
+  *pmode = t->curr->modes[t->next];
+  ++t->next;
+  ++t->refs;
+
+  return 1;
+}
+
+/* ========================================================================== */
+
+static int decode_ref(struct trace *t, uint32_t *ppid, uint32_t *paddr, char *pmode)
+{
+  char *line;
+
+  while ((line = next_line(t)))
+  {
+    char *str = line;
+    *ppid = 0;
+
+    if (t->tagged)
+    {
+      unsigned long pid = strtoul(line, &str, 10);
+      if (str == line) continue;                      // Malformed
+
+      *ppid = (pid > UINT32_MAX ? UINT32_MAX : pid);
+    }
+
+    if (parse_ref(str, paddr, pmode)) return 1;     // Skip malformed lines
+  }
+  return 0;
+}
+
+/* ========================================================================== */
+
+static char *next_line(struct trace *t)
+{
+  for (;;)
+  {
+    char *nl = memchr(t->buf + t->pos, '\n', t->len - t->pos);
+
+    if (nl == NULL)
+    {                                   // Refill, keeping the partial line
+      memmove(t->buf, t->buf + t->pos, t->len - t->pos);
+      t->buf_off += t->pos;
+      t->len -= t->pos;
+      t->pos  = 0;
+
+      ssize_t rd = 0;
+      if (t->len < TRACE_BUF_SIZE - 1)
+        rd = input_read(t, t->buf + t->len, TRACE_BUF_SIZE - 1 - t->len);
+
+      if (rd == -1 && errno == EINTR) continue;
+
+      if (rd == -1)
+      {                                 // The partial line isn't a reference
+        t->error = errno;
+        return NULL;
+      }
+
+      if (rd == 0)
+      {
+        if (t->len == 0) return NULL;
+
+        t->buf[t->len] = '\0';          // Last line, without a newline
+        t->pos = t->len;
+        return t->buf;
+      }
+
+      t->len += rd;
+      continue;
+    }
+
+    char *line = t->buf + t->pos;
+    *nl = '\0';
+    t->pos = nl - t->buf + 1;
+
+    if (line[0] != '\0' && line[0] != '\r')
+      return line;
+  }
+}
+
+/* ========================================================================== */
+
+static int input_detect(struct trace *t)
+{
+  while (t->raw_len < 4)              // Magic numbers: gzip 1f 8b, zstd 28 b5 2f fd
+  {
+    ssize_t rd = read(t->fd, t->raw + t->raw_len, 4 - t->raw_len);
+
+    if (rd == -1 && errno == EINTR) continue;
+    if (rd <= 0) break;
+
+    t->raw_len += rd;
+  }
+
+  unsigned char *m = t->raw;
+
+  if (t->raw_len >= 2 && m[0] == 0x1f && m[1] == 0x8b)
+    t->format = TRACE_GZIP;
+  else if (t->raw_len >= 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd)
+    t->format = TRACE_ZSTD;
+  else
+    return 1;                         // Plain text, the bytes read are its start
+
+#ifdef HAVE_ZLIB
+  if (t->format == TRACE_GZIP)
+  {
+    z_stream *z = calloc(1, sizeof(z_stream));
+
+    if (z == NULL || inflateInit2(z, 15 + 16) != Z_OK)     // gzip wrapper only
+    {
+      free(z);
+      errno = ENOMEM;
+      return 0;
+    }
+    t->stream = z;
+    return 1;
+  }
+#endif
+
+#ifdef HAVE_ZSTD
+  if (t->format == TRACE_ZSTD)
+  {
+    t->stream = ZSTD_createDCtx();
+    if (t->stream == NULL)
+    {
+      errno = ENOMEM;
+      return 0;
+    }
+    return 1;
+  }
+#endif
+
+  t->format = TRACE_PLAIN;            // Nothing to free
+  errno = ENOTSUP;
+  return 0;
+}
+
+/* ========================================================================== */
+
+static ssize_t input_read(struct trace *t, char *dst, size_t n)
+{
+  if (t->format == TRACE_PLAIN)
+  {
+    if (t->raw_pos == t->raw_len)
+      return read(t->fd, dst, n);
+
+    size_t k = (t->raw_len - t->raw_pos < n ? t->raw_len - t->raw_pos : n);
+    memcpy(dst, t->raw + t->raw_pos, k);      // Bytes read to tell the format
+    t->raw_pos += k;
+    return k;
+  }
+
+  size_t done = 0;
+
+  while (done == 0)
+  {
+    ssize_t avail = raw_fill(t);
+
+    if (avail == -1) return -1;
+    if (avail == 0 && !t->in_stream) return 0;      // Every stream ended with the input
+
+#ifdef HAVE_ZLIB
+    if (t->format == TRACE_GZIP)
+    {
+      z_stream *z = t->stream;
+
+      z->next_in   = t->raw + t->raw_pos;
+      z->avail_in  = avail;
+      z->next_out  = (unsigned char *) dst;
+      z->avail_out = n;
+
+      t->in_stream = 1;
+      int ret = inflate(z, Z_NO_FLUSH);
+
+      t->raw_pos += avail - z->avail_in;
+      done = n - z->avail_out;
+
+      if (ret == Z_STREAM_END)
+      {
+        inflateReset(z);              // Concatenated members go on
+        t->in_stream = 0;
+      }
+      else if (ret != Z_OK && ret != Z_BUF_ERROR)
+      {
+        errno = EIO;
+        return -1;
+      }
+    }
+#endif
+
+#ifdef HAVE_ZSTD
+    if (t->format == TRACE_ZSTD)
+    {
+      ZSTD_inBuffer  in  = { t->raw + t->raw_pos, avail, 0 };
+      ZSTD_outBuffer out = { dst, n, 0 };
+
+      size_t ret = ZSTD_decompressStream(t->stream, &out, &in);
+
+      t->raw_pos += in.pos;
+      done = out.pos;
+
+      if (ZSTD_isError(ret))
+      {
+        errno = EIO;
+        return -1;
+      }
+      t->in_stream = (ret != 0);      // 0 once a frame is decoded and flushed
+    }
+#endif
+
+    if (avail == 0 && done == 0 && t->in_stream)
+    {                                 // The input ends in the middle of a stream
+      errno = EIO;
+      return -1;
+    }
+  }
+
+  return done;
+}
+
+/* ========================================================================== */
+
+static int input_restart(struct trace *t, uint64_t off)
+{
+  if (lseek(t->fd, t->origin, SEEK_SET) == -1)
+    return 0;
+
+  t->raw_pos = t->raw_len = 0;
+  t->in_stream = 0;
+
+#ifdef HAVE_ZLIB
+  if (t->format == TRACE_GZIP)
+    inflateReset(t->stream);
+#endif
+#ifdef HAVE_ZSTD
+  if (t->format == TRACE_ZSTD)
+    ZSTD_DCtx_reset(t->stream, ZSTD_reset_session_only);
+#endif
+
+  while (off > 0)                     // Discard what comes before `off`
+  {
+    ssize_t rd = input_read(t, t->buf, (off < TRACE_BUF_SIZE ? off : TRACE_BUF_SIZE));
+
+    if (rd == -1 && errno == EINTR) continue;
+    if (rd <= 0) return 0;
+
+    off -= rd;
+  }
+  return 1;
+}
+
+/* ========================================================================== */
+
+static ssize_t raw_fill(struct trace *t)
+{
+  while (t->raw_pos == t->raw_len)
+  {
+    ssize_t rd = read(t->fd, t->raw, TRACE_RAW_SIZE);
+
+    if (rd == -1 && errno == EINTR) continue;
+    if (rd <= 0) return rd;
+
+    t->raw_pos = 0;
+    t->raw_len = rd;
+  }
+  return t->raw_len - t->raw_pos;
+}
+
+/* ========================================================================== */
+
+static void input_end(struct trace *t)
+{
+  if (t->stream == NULL) return;
+
+#ifdef HAVE_ZLIB
+  if (t->format == TRACE_GZIP)
+  {
+    inflateEnd(t->stream);
+    free(t->stream);
+  }
+#endif
+#ifdef HAVE_ZSTD
+  if (t->format == TRACE_ZSTD)
+    ZSTD_freeDCtx(t->stream);
+#endif
+
+  t->stream = NULL;
+}
+
+/* ========================================================================== */
+
+static int parse_ref(char *str, uint32_t *paddr, char *pmode)
+{
+  char *end;
+  *paddr = strtoul(str, &end, 16);
+
+  if (end == str) return 0;
+
+  while (*end == ' ' || *end == '\t') ++end;
+
+  if (*end != 'R' && *end != 'W') return 0;
+
+  *pmode = *end;
+  return 1;
+}
+
+/* ========================================================================== */
+
+static void backoff(unsigned *spins)
+{
+  if ((*spins)++ < 64)
+  {
+    sched_yield();
+    return;
+  }
+
+  struct timespec nap = { .tv_sec = 0, .tv_nsec = 50000 };
+  nanosleep(&nap, NULL);
+}
+
+/* ========================================================================== */
+
+struct trace_mux *mux_open(const char *path, uint8_t *pids, size_t cap)
+{
+  struct trace_mux *mux = calloc(1, sizeof(struct trace_mux));
+  if (mux == NULL) return NULL;
+
+  mux->in  = open_input(path, 1);
+  mux->cap = (cap ? cap : MUX_QUEUE_REFS);
+
+  if (mux->in == NULL)
+  {
+    free(mux);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    mux->pids[i] = pids[i];
+    mux->ports[i] = (struct mux_port) { .mux = mux, .index = i };
+
+    mux->queue[i].addrs = malloc(mux->cap * sizeof(uint32_t));
+    mux->queue[i].modes = malloc(mux->cap * sizeof(char));
+
+    if (mux->queue[i].addrs == NULL || mux->queue[i].modes == NULL)
+    {
+      mux_close(mux);
+      errno = ENOMEM;
+      return NULL;
+    }
+  }
+
+  return mux;
+}
+
+/* ========================================================================== */
+
+int mux_read(void *port, uint32_t *paddr, char *pmode)
+{
+  struct trace_mux *mux = ((struct mux_port *) port)->mux;
+  size_t index = ((struct mux_port *) port)->index;
+
+  struct mux_queue *q = &mux->queue[index];
+
+  while (q->count == 0)       // Read the stream until a record of `index` shows up
+  {
+    if (mux->held)
+    {
+      if (mux_push(mux, mux->held_index, mux->held_addr, mux->held_mode) == 0)
+        return REF_AGAIN;     // Another process has to consume its records first
+
+      mux->held = 0;
+      continue;
+    }
+
+    uint32_t pid, addr;
+    char mode;
+
+    int got = (mux->end ? 0 : trace_next(mux->in, &pid, &addr, &mode));
+
+    if (got == -1)
+      return REF_ERROR;
+
+    if (got == 0)
+    {
+      mux->end = 1;
+      return REF_END;
+    }
+
+    int i = mux_index(mux, pid);
+    if (i == -1)
+    {
+      ++mux->unknown;
+      continue;
+    }
+
+    mux->held = 1;            // Queued on the next iteration, if there's room
+    mux->held_index = i;
+    mux->held_addr  = addr;
+    mux->held_mode  = mode;
+  }
+
+  *paddr = q->addrs[q->head];
+  *pmode = q->modes[q->head];
+
+  q->head = (q->head + 1) % mux->cap;
+  --q->count;
+
+  return REF_OK;
+}
+
+/* ========================================================================== */
+
+void mux_close(struct trace_mux *mux)
+{
+  for (size_t i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    free(mux->queue[i].addrs);
+    free(mux->queue[i].modes);
+  }
+
+  trace_close(mux->in);
+  free(mux);
+}
+
+/* ========================================================================== */
+
+static int mux_push(struct trace_mux *mux, size_t index, uint32_t addr, char mode)
+{
+  struct mux_queue *q = &mux->queue[index];
+
+  if (q->count == mux->cap)
+    return 0;
+
+  size_t tail = (q->head + q->count) % mux->cap;
+
+  q->addrs[tail] = addr;
+  q->modes[tail] = mode;
+  ++q->count;
+
+  return 1;
+}
+
+/* ========================================================================== */
+
+static int mux_index(struct trace_mux *mux, unsigned long pid)
+{
+  for (int i = 0; i < NUM_OF_PROCESSES; ++i)
+  {
+    if (mux->pids[i] == pid)
+      return i;
+  }
+  return -1;
+}
+
+/* ========================================================================== */
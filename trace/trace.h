@@ -0,0 +1,167 @@
+/* trace.h */
+#ifndef TRACE_MODULE
+#define TRACE_MODULE
+
+#include <pthread.h>    // pthread_t
+#include <stdatomic.h>  // atomic_size_t, atomic_bool
+#include <stdbool.h>    // bool
+#include <stdint.h>     // uint8_t, uint32_t, size_t
+
+#include "memory.h"     // NUM_OF_PROCESSES
+
+#define TRACE_BUF_SIZE (1 << 16)    // Bytes buffered from every input
+#define TRACE_RAW_SIZE (1 << 16)    // Compressed bytes read at once
+#define TRACE_BATCH    4096         // References decoded at once
+#define TRACE_RING     4            // Batches in flight between reader and simulation
+#define MUX_QUEUE_REFS 4096         // Default # references queued per process
+
+/* Inputs may be regular files, named pipes or "-" for stdin.      *
+ * A trace holds one reference per line:    "<hex address> <R|W>"  *
+ * A multiplexed stream tags it with a PID: "<pid> <hex address> <R|W>" *
+ * Every input is decoded by a reader thread, ahead of the simulation. *
+ * Inputs compressed with gzip or zstd (told by their magic number) are *
+ * decompressed on the way, in bounded chunks, by the same thread.     *
+ * Their offsets count decompressed bytes.                             */
+
+enum trace_format { TRACE_PLAIN, TRACE_GZIP, TRACE_ZSTD };
+
+// References decoded by the reader thread, in trace order
+struct trace_batch
+{
+  size_t n;
+  uint64_t offset;                  // Input offset of the first reference
+  uint64_t end;                     // Input offset right after the last one
+  uint32_t addrs[TRACE_BATCH];
+  char     modes[TRACE_BATCH];
+  uint32_t pids [TRACE_BATCH];      // Only set for streams tagged by PID
+};
+
+
+// Input of references
+struct trace
+{
+  int  fd;
+  bool tagged;                // Records start with a PID
+  bool seekable;              // Can be replayed
+  enum trace_format format;
+  uint64_t origin;            // File offset the input starts at
+
+  /* Owned by the reader thread */
+  char *buf;                  // Bounded read buffer
+  size_t pos, len;            // Undecoded bytes are buf[pos, len)
+  uint64_t buf_off;           // Input offset of buf[0]
+
+  unsigned char *raw;         // Bytes read from the file, not decompressed yet
+  size_t raw_pos, raw_len;    // They are raw[raw_pos, raw_len)
+  void *stream;               // Decompressor state, NULL if plain
+  bool in_stream;             // A compressed stream (gzip member, zstd frame) is still open
+  pthread_t reader;
+  bool running;               // The reader thread was started and not joined yet
+
+  /* Lock-free single producer, single consumer ring of batches */
+  struct trace_batch *ring;
+  atomic_size_t head;         // # Batches consumed by the simulation
+  atomic_size_t tail;         // # Batches filled by the reader
+  atomic_bool   end;          // The reader reached the end of the input
+  int error;                  // errno if the input couldn't be read to its end, else 0
+  atomic_bool   stop;         // The reader has to exit
+
+  /* Owned by the simulation thread */
+  struct trace_batch *curr;   // Batch being consumed, NULL if none
+  size_t next;                // Index of the next reference in `curr`
+  size_t refs;                // # References consumed
+  uint64_t resume;            // Input offset after the last batch handed back
+};
+
+
+// References of a process read from a stream, but not consumed yet
+struct mux_queue
+{
+  uint32_t *addrs;
+  char     *modes;
+  size_t head;                // Index of the oldest reference
+  size_t count;
+};
+
+
+// Handle given as the source of process `index` of a stream
+struct mux_port
+{
+  struct trace_mux *mux;
+  size_t index;
+};
+
+
+// Stream carrying the references of every process, tagged by PID
+struct trace_mux
+{
+  struct trace *in;
+  uint8_t pids[NUM_OF_PROCESSES];
+
+  struct mux_queue queue[NUM_OF_PROCESSES];   // Demultiplexed references
+  struct mux_port  ports[NUM_OF_PROCESSES];
+  size_t cap;                                 // Max references per queue
+
+  bool held;                  // A record is waiting for room in its queue
+  size_t   held_index;
+  uint32_t held_addr;
+  char     held_mode;
+
+  bool end;                   // The stream ended
+  size_t unknown;             // # Records of untracked PIDs, dropped
+};
+
+
+/* Opens the trace of a process and starts its reader.          *
+ * Returns NULL on failure, errno is set (ENOTSUP: compressed   *
+ * with a format the simulator was built without).              */
+struct trace *trace_open(const char *path);
+
+
+/* Reads a reference and its mode (R/W) from a trace (a `ref_source`).  *
+ * Returns REF_OK, REF_END if we reached the end of the trace, or       *
+ * REF_ERROR if it couldn't be read to its end (EIO: a compressed      *
+ * trace cut short or corrupt), errno is set.                           */
+int  trace_read(void *trace, uint32_t *paddr, char *pmode);
+
+
+/* Moves back to the start of the trace.              *
+ * Returns 0 if the trace can't be replayed, else 1.   */
+int  trace_rewind(struct trace *t);
+
+
+/* Gets the position of the next reference the simulation will consume: *
+ * skip `*pskip` references starting from input offset `*poff`.         */
+void trace_tell(struct trace *t, uint64_t *poff, size_t *pskip);
+
+
+/* Moves to a position given by `trace_tell()`. A compressed trace *
+ * is decompressed again from its start, up to the position.       *
+ * Returns 0 if the trace can't be replayed (or its reader can't be *
+ * restarted, the trace then ends), else 1.                         */
+int  trace_seek(struct trace *t, uint64_t off, size_t skip);
+
+
+/* Stops the reader and closes the trace. */
+void trace_close(struct trace *t);
+
+
+/* Opens a multiplexed stream for the processes `pids`.           *
+ * Up to `cap` references are queued per process: when a queue   *
+ * is full, the stream isn't read further (backpressure).         *
+ * Returns NULL on failure, errno is set.                         */
+struct trace_mux *mux_open(const char *path, uint8_t *pids, size_t cap);
+
+
+/* Reads the next reference of a process from a stream (a `ref_source`). *
+ * `port` is one of `mux->ports`. Returns REF_OK, REF_END, REF_AGAIN     *
+ * if the queue of another process must be drained first, or REF_ERROR  *
+ * as `trace_read()`.                                                    */
+int  mux_read(void *port, uint32_t *paddr, char *pmode);
+
+
+/* Closes the stream. */
+void mux_close(struct trace_mux *mux);
+
+
+#endif